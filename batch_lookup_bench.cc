@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+// Sets from the size of L2 to way bigger than LLC.
+constexpr int kMinSetSize = 1 << 20;
+constexpr int kMaxSetSize = 1 << 26;
+constexpr size_t kBatchSize = 256;
+
+using int_vec = std::vector<int>;
+using const_iterator = lib::flat_set<int>::const_iterator;
+
+void set_sizes(benchmark::internal::Benchmark* bench) {
+  bench->RangeMultiplier(4)->Range(kMinSetSize, kMaxSetSize);
+}
+
+lib::flat_set<int> make_set(int size) {
+  int_vec v(static_cast<size_t>(size));
+  std::iota(v.begin(), v.end(), 0);
+  return lib::flat_set<int>(std::move(v));
+}
+
+int_vec random_queries(int size) {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, size);
+  int_vec res(kBatchSize * 64);
+  std::generate(res.begin(), res.end(), [&] { return dis(g); });
+  return res;
+}
+
+template <typename Lookup>
+void batch_bench(benchmark::State& state, Lookup lookup) {
+  const int size = static_cast<int>(state.range(0));
+  const auto c = make_set(size);
+  const auto queries = random_queries(size);
+  std::vector<const_iterator> out(kBatchSize);
+
+  size_t batch = 0;
+  while (state.KeepRunning()) {
+    auto f = queries.begin() + batch * kBatchSize;
+    lookup(c, f, f + kBatchSize, out.begin());
+    benchmark::DoNotOptimize(out.data());
+    batch = (batch + 1) % (queries.size() / kBatchSize);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+void lower_bound_loop(benchmark::State& state) {
+  batch_bench(state, [](const auto& c, auto f, auto l, auto o) {
+    for (; f != l; ++f, ++o)
+      *o = c.lower_bound(*f);
+  });
+}
+
+void lower_bound_batch(benchmark::State& state) {
+  batch_bench(state, [](const auto& c, auto f, auto l, auto o) {
+    c.lower_bound_batch(f, l, o);
+  });
+}
+
+void find_loop(benchmark::State& state) {
+  batch_bench(state, [](const auto& c, auto f, auto l, auto o) {
+    for (; f != l; ++f, ++o)
+      *o = c.find(*f);
+  });
+}
+
+void find_batch(benchmark::State& state) {
+  batch_bench(state, [](const auto& c, auto f, auto l, auto o) {
+    c.find_batch(f, l, o);
+  });
+}
+
+}  // namespace
+
+BENCHMARK(lower_bound_loop)->Apply(set_sizes);
+BENCHMARK(lower_bound_batch)->Apply(set_sizes);
+BENCHMARK(find_loop)->Apply(set_sizes);
+BENCHMARK(find_batch)->Apply(set_sizes);
+
+BENCHMARK_MAIN();
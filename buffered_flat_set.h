@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lib.h"
+
+namespace lib {
+
+namespace detail {
+
+// Walks two sorted ranges without common elements as one.
+template <typename I, typename Comparator>
+class buffered_iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename std::iterator_traits<I>::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = const value_type&;
+  using pointer = const value_type*;
+
+  buffered_iterator() = default;
+  buffered_iterator(I sorted, I sorted_l, I buffer, I buffer_l,
+                    Comparator comp)
+      : sorted_(sorted),
+        sorted_l_(sorted_l),
+        buffer_(buffer),
+        buffer_l_(buffer_l),
+        comp_(comp) {}
+
+  reference operator*() const { return from_buffer() ? *buffer_ : *sorted_; }
+  pointer operator->() const { return &**this; }
+
+  buffered_iterator& operator++() {
+    if (from_buffer())
+      ++buffer_;
+    else
+      ++sorted_;
+    return *this;
+  }
+
+  buffered_iterator operator++(int) {
+    auto res = *this;
+    ++*this;
+    return res;
+  }
+
+  friend bool operator==(const buffered_iterator& x,
+                         const buffered_iterator& y) {
+    return x.sorted_ == y.sorted_ && x.buffer_ == y.buffer_;
+  }
+
+  friend bool operator!=(const buffered_iterator& x,
+                         const buffered_iterator& y) {
+    return !(x == y);
+  }
+
+ private:
+  bool from_buffer() const {
+    if (buffer_ == buffer_l_)
+      return false;
+    Comparator comp = comp_;
+    return sorted_ == sorted_l_ || comp(*buffer_, *sorted_);
+  }
+
+  I sorted_, sorted_l_, buffer_, buffer_l_;
+  Comparator comp_;
+};
+
+}  // namespace detail
+
+// flat_set for a lot of single element inserts.
+// New elements go into a small sorted buffer, and lookups search it before
+// searching the sorted part. When the buffer is full, it is merged into the
+// sorted part in one go, so an insert costs O(buffer + n / buffer) instead
+// of O(n). The buffer grows as sqrt(size()), which balances the two.
+//
+// Iteration walks both parts as one merged range and does not change the
+// set, so const member functions are safe to call from many threads at once.
+// flush() merges the buffer explicitly.
+template <typename Key,
+          typename Comparator = less,
+          typename UnderlyingType = std::vector<Key>>
+// requires (todo)
+class buffered_flat_set {
+ public:
+  using sorted_type = flat_set<Key, Comparator, UnderlyingType>;
+  using underlying_type = UnderlyingType;
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = typename underlying_type::size_type;
+  using difference_type = typename underlying_type::difference_type;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+  using const_reference = typename underlying_type::const_reference;
+  using iterator =
+      detail::buffered_iterator<typename underlying_type::const_iterator,
+                                value_compare>;
+  using const_iterator = iterator;
+
+  // The buffer is never smaller than this.
+  static constexpr size_type kMinBufferSize = 32;
+
+ private:
+  sorted_type sorted_;
+  underlying_type buffer_;
+
+  template <typename V>
+  using type_for_value_compare =
+      typename std::conditional<TransparentComparator<value_compare>(),
+                                V,
+                                value_type>::type;
+
+  template <typename V>
+  Iterator<underlying_type> buffer_lower_bound(const V& v) {
+    const type_for_value_compare<V>& v_ref = v;
+    return std::lower_bound(buffer_.begin(), buffer_.end(), v_ref,
+                            value_comp());
+  }
+
+  template <typename V>
+  bool found_in_buffer(typename underlying_type::const_iterator pos,
+                       const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    return pos != buffer_.end() && !value_comp()(v_ref, *pos);
+  }
+
+  size_type buffer_limit() const {
+    auto root = static_cast<size_type>(
+        std::sqrt(static_cast<double>(sorted_.size())));
+    return std::max(kMinBufferSize, root);
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  buffered_flat_set() = default;
+  explicit buffered_flat_set(const key_compare& comp) : sorted_(comp) {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  buffered_flat_set(I f, I l, const key_compare& comp = key_compare())
+      : sorted_(f, l, comp) {}
+
+  buffered_flat_set(std::initializer_list<value_type> il,
+                    const key_compare& comp = key_compare())
+      : sorted_(il, comp) {}
+
+  explicit buffered_flat_set(sorted_type sorted)
+      : sorted_(std::move(sorted)) {}
+
+  buffered_flat_set(const buffered_flat_set&) = default;
+  buffered_flat_set(buffered_flat_set&&) = default;
+  buffered_flat_set& operator=(const buffered_flat_set&) = default;
+  buffered_flat_set& operator=(buffered_flat_set&&) = default;
+
+  ~buffered_flat_set() = default;
+
+  //---------------------------------------------------------------------------
+  // Size management.
+
+  size_type size() const { return sorted_.size() + buffer_.size(); }
+  bool empty() const { return sorted_.empty() && buffer_.empty(); }
+
+  void clear() {
+    sorted_.clear();
+    buffer_.clear();
+  }
+
+  //---------------------------------------------------------------------------
+  // Iterators. Do not merge the buffer.
+
+  const_iterator begin() const {
+    return {sorted_.body().begin(), sorted_.body().end(), buffer_.begin(),
+            buffer_.end(), value_comp()};
+  }
+  const_iterator cbegin() const { return begin(); }
+
+  const_iterator end() const {
+    return {sorted_.body().end(), sorted_.body().end(), buffer_.end(),
+            buffer_.end(), value_comp()};
+  }
+  const_iterator cend() const { return end(); }
+
+  //---------------------------------------------------------------------------
+  // Insert operations.
+
+  // Returns false if v was already in the set.
+  template <typename V>
+  bool insert(V&& v) {
+    auto pos = buffer_lower_bound(v);
+    if (found_in_buffer(pos, v) || sorted_.count(v))
+      return false;
+
+    buffer_.insert(pos, std::forward<V>(v));
+    if (buffer_.size() >= buffer_limit())
+      flush();
+    return true;
+  }
+
+  template <typename... Args>
+  bool emplace(Args&&... args) {
+    return insert(value_type(std::forward<Args>(args)...));
+  }
+
+  template <typename I>
+  void insert(I f, I l) {
+    flush();
+    sorted_.insert(f, l);
+  }
+
+  // Merges the buffer into the sorted part.
+  void flush() {
+    if (buffer_.empty())
+      return;
+    // Elements of the buffer are sorted, unique and not in sorted_ yet.
+    sorted_.insert(sorted_unique, std::make_move_iterator(buffer_.begin()),
+                   std::make_move_iterator(buffer_.end()));
+    buffer_.clear();
+  }
+
+  // --------------------------------------------------------------------------
+  // Erase operations.
+
+  template <typename V>
+  size_type erase(const V& v) {
+    auto pos = buffer_lower_bound(v);
+    if (!found_in_buffer(pos, v))
+      return sorted_.erase(v);
+
+    buffer_.erase(pos);
+    return 1;
+  }
+
+  // --------------------------------------------------------------------------
+  // Search operations. Do not merge the buffer.
+
+  template <typename V>
+  bool contains(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    auto pos = std::lower_bound(buffer_.begin(), buffer_.end(), v_ref,
+                                value_comp());
+    return found_in_buffer(pos, v) || sorted_.count(v);
+  }
+
+  template <typename V>
+  size_type count(const V& v) const {
+    return contains(v) ? 1 : 0;
+  }
+
+  //---------------------------------------------------------------------------
+  // Getters.
+
+  key_compare key_comp() const { return sorted_.key_comp(); }
+  value_compare value_comp() const { return sorted_.value_comp(); }
+
+  // Merges the buffer.
+  const sorted_type& sorted() {
+    flush();
+    return sorted_;
+  }
+
+  //---------------------------------------------------------------------------
+  // General operations.
+
+  void swap(buffered_flat_set& x) {
+    sorted_.swap(x.sorted_);
+    buffer_.swap(x.buffer_);
+  }
+
+  friend void swap(buffered_flat_set& x, buffered_flat_set& y) { x.swap(y); }
+
+  friend bool operator==(const buffered_flat_set& x,
+                         const buffered_flat_set& y) {
+    return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend bool operator!=(const buffered_flat_set& x,
+                         const buffered_flat_set& y) {
+    return !(x == y);
+  }
+};
+
+template <typename Key, typename Comparator, typename UnderlyingType>
+constexpr typename buffered_flat_set<Key, Comparator, UnderlyingType>::
+    size_type buffered_flat_set<Key, Comparator, UnderlyingType>::
+        kMinBufferSize;
+
+}  // namespace lib
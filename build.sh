@@ -1,3 +1,3 @@
-clang++ --std=c++14 -O2 -Werror  -Wall $1 \
+clang++ --std=c++14 -O2 -Werror  -Wall -pthread $1 \
   -I /space/google_benchmark/benchmark/include/ /space/google_benchmark/build/src/libbenchmark.a \
   -I /space/chromium/src/
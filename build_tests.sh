@@ -1 +1 @@
-clang++ -O1 -fsanitize=address -fno-omit-frame-pointer --std=c++14  -Werror -Wall -g set_unions_test.cc
+clang++ -O1 -fsanitize=address -fno-omit-frame-pointer --std=c++14 -msse4.2 -Werror -Wall -g set_unions_test.cc
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <map>
+#include <numeric>
 #include <random>
 #include <set>
 #include <unordered_set>
@@ -12,38 +14,130 @@
 #include "benchmark/benchmark.h"
 
 using value_type = int;
-constexpr size_t kSize = 1000;
 
 namespace {
 
-std::vector<value_type> generate_input() {
-  static auto res = [] {
-    std::mt19937 g;
-    std::uniform_int_distribution<> dis(1, 10000);
+constexpr int kSmallSize = 1000;
+constexpr int kLargeSize = 50 * 1000 * 1000;
 
-    std::vector<value_type> v(kSize);
-    std::generate(v.begin(), v.end(), [&] { return dis(g); });
-    return v;
-  }();
+const std::vector<value_type>& generate_input(size_t size) {
+  static std::map<size_t, std::vector<value_type>> cache;
 
+  auto& res = cache[size];
+  if (res.size() == size)
+    return res;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(1, static_cast<int>(size) * 10);
+  res.resize(size);
+  std::generate(res.begin(), res.end(), [&] { return dis(g); });
   return res;
 }
 
+// Node based containers are too slow to build from 50M elements.
+void small_sizes(benchmark::internal::Benchmark* bench) {
+  bench->Arg(kSmallSize)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+}
+
+void all_sizes(benchmark::internal::Benchmark* bench) {
+  small_sizes(bench);
+  bench->Arg(10 * 1000 * 1000)->Arg(kLargeSize)->UseRealTime();
+}
+
 template <typename contaier>
 void range_construction(benchmark::State& state) {
-  std::vector<value_type> v = generate_input();
+  const auto& v = generate_input(static_cast<size_t>(state.range(0)));
 
   while(state.KeepRunning())
     benchmark::DoNotOptimize(contaier(v.begin(), v.end()));
 }
 
+// Sorted input, where the last disorder% elements are replaced with random
+// ones.
+std::vector<value_type> nearly_sorted_input(size_t size, size_t disorder) {
+  std::vector<value_type> res = generate_input(size);
+  auto tail = res.end() - static_cast<std::ptrdiff_t>(size * disorder / 100);
+  std::sort(res.begin(), tail);
+  return res;
+}
+
+void disorder_percents(benchmark::internal::Benchmark* bench) {
+  for (int disorder : {0, 1, 10, 100})
+    bench->Arg(disorder);
+  bench->Unit(benchmark::kMillisecond);
+}
+
+void nearly_sorted_std_sort(benchmark::State& state) {
+  const auto input = nearly_sorted_input(
+      1 << 20, static_cast<size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<value_type> v = input;
+    state.ResumeTiming();
+
+    std::sort(v.begin(), v.end());
+    benchmark::DoNotOptimize(std::unique(v.begin(), v.end()));
+  }
+}
+
+void nearly_sorted_construction(benchmark::State& state) {
+  const auto input = nearly_sorted_input(
+      1 << 20, static_cast<size_t>(state.range(0)));
+
+  while(state.KeepRunning())
+    benchmark::DoNotOptimize(
+        lib::flat_set<value_type>(input.begin(), input.end()));
+}
+
+// Already sorted and unique input: one copy.
+void sorted_unique_construction(benchmark::State& state) {
+  std::vector<value_type> input(static_cast<size_t>(state.range(0)));
+  std::iota(input.begin(), input.end(), 0);
+
+  while(state.KeepRunning())
+    benchmark::DoNotOptimize(lib::flat_set<value_type>(
+        lib::sorted_unique, input.begin(), input.end()));
+}
+
+void sort_and_unique_threads(benchmark::State& state) {
+  const auto& input = generate_input(kLargeSize);
+  const size_t threads = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<value_type> v = input;
+    state.ResumeTiming();
+
+    benchmark::DoNotOptimize(
+        lib::sort_and_unique_parallel(v.begin(), v.end(), lib::less{},
+                                      threads));
+  }
+}
+
 }  // namespace
 
-BENCHMARK_TEMPLATE(range_construction, lib::flat_set<value_type>);
-BENCHMARK_TEMPLATE(range_construction, folly::sorted_vector_set<value_type>);
-BENCHMARK_TEMPLATE(range_construction, base::flat_set<value_type>);
-BENCHMARK_TEMPLATE(range_construction, boost::container::flat_set<value_type>);
-BENCHMARK_TEMPLATE(range_construction, std::unordered_set<value_type>);
-BENCHMARK_TEMPLATE(range_construction, std::set<value_type>);
+BENCHMARK_TEMPLATE(range_construction, lib::flat_set<value_type>)
+    ->Apply(all_sizes);
+BENCHMARK_TEMPLATE(range_construction, folly::sorted_vector_set<value_type>)
+    ->Apply(all_sizes);
+BENCHMARK_TEMPLATE(range_construction, base::flat_set<value_type>)
+    ->Apply(all_sizes);
+BENCHMARK_TEMPLATE(range_construction, boost::container::flat_set<value_type>)
+    ->Apply(all_sizes);
+BENCHMARK_TEMPLATE(range_construction, std::unordered_set<value_type>)
+    ->Apply(small_sizes);
+BENCHMARK_TEMPLATE(range_construction, std::set<value_type>)
+    ->Apply(small_sizes);
+
+BENCHMARK(nearly_sorted_std_sort)->Apply(disorder_percents);
+BENCHMARK(nearly_sorted_construction)->Apply(disorder_percents);
+
+BENCHMARK(sorted_unique_construction)->Apply(all_sizes);
+
+BENCHMARK(sort_and_unique_threads)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "lib.h"
+
+namespace lib {
+
+namespace detail {
+
+// Reference counted pointer for cow_flat_set.
+// shared_ptr::use_count() is a relaxed load: seeing 1 there does not mean
+// that the other owners are done reading, which is why shared_ptr::unique()
+// was deprecated. Here unique() loads the count with acquire and the
+// owners release it with acq_rel, so after unique() returns true all of the
+// reads through the other copies have happened before.
+template <typename T>
+class cow_ptr {
+  struct node {
+    template <typename... Args>
+    explicit node(Args&&... args) : value(std::forward<Args>(args)...) {}
+
+    std::atomic<std::size_t> refs{1};
+    T value;
+  };
+
+ public:
+  cow_ptr() = default;
+
+  template <typename... Args>
+  static cow_ptr make(Args&&... args) {
+    cow_ptr res;
+    res.node_ = new node(std::forward<Args>(args)...);
+    return res;
+  }
+
+  cow_ptr(const cow_ptr& x) noexcept : node_(x.node_) {
+    if (node_)
+      node_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  cow_ptr(cow_ptr&& x) noexcept : node_(x.node_) { x.node_ = nullptr; }
+
+  cow_ptr& operator=(cow_ptr x) noexcept {
+    swap(x);
+    return *this;
+  }
+
+  ~cow_ptr() { reset(); }
+
+  void reset() noexcept {
+    if (node_ && node_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete node_;
+    node_ = nullptr;
+  }
+
+  bool unique() const {
+    return node_->refs.load(std::memory_order_acquire) == 1;
+  }
+
+  T& operator*() const { return node_->value; }
+  T* operator->() const { return &node_->value; }
+  explicit operator bool() const { return node_ != nullptr; }
+
+  void swap(cow_ptr& x) noexcept { std::swap(node_, x.node_); }
+
+  friend bool operator==(const cow_ptr& x, const cow_ptr& y) {
+    return x.node_ == y.node_;
+  }
+
+ private:
+  node* node_ = nullptr;
+};
+
+}  // namespace detail
+
+// flat_set with copy on write.
+// Copies share one reference counted flat_set, the first mutation of a
+// shared copy makes a private one. Good for sets that are copied a lot and
+// rarely changed. Reads go straight to the shared flat_set.
+//
+// Different copies of the same set can be read, changed and destroyed from
+// different threads at the same time: a copy decides to change the shared
+// flat_set in place only after all of the other copies have let it go. One
+// copy is not thread safe by itself, same as a flat_set.
+template <typename Key,
+          typename Comparator = less,
+          typename UnderlyingType = std::vector<Key>>
+// requires (todo)
+class cow_flat_set {
+ public:
+  using sorted_type = flat_set<Key, Comparator, UnderlyingType>;
+  using underlying_type = UnderlyingType;
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = typename underlying_type::size_type;
+  using difference_type = typename underlying_type::difference_type;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+  using reference = typename underlying_type::const_reference;
+  using const_reference = typename underlying_type::const_reference;
+  using iterator = typename sorted_type::const_iterator;
+  using const_iterator = iterator;
+  using reverse_iterator = typename sorted_type::const_reverse_iterator;
+  using const_reverse_iterator = reverse_iterator;
+
+ private:
+  struct impl_t : value_compare {
+    impl_t() = default;
+
+    explicit impl_t(const value_compare& comp) : value_compare(comp) {}
+    impl_t(const value_compare& comp, detail::cow_ptr<sorted_type> body)
+        : value_compare(comp), body_(std::move(body)) {}
+
+    // nullptr is an empty set, so that default constructed and moved from
+    // sets do not allocate.
+    detail::cow_ptr<sorted_type> body_;
+  } impl_;
+
+  static const sorted_type& empty_set() {
+    static const sorted_type res;
+    return res;
+  }
+
+  const sorted_type& set() const {
+    return impl_.body_ ? *impl_.body_ : empty_set();
+  }
+
+  // Detaches from other copies.
+  sorted_type& mutable_set() {
+    unshare();
+    return *impl_.body_;
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  cow_flat_set() = default;
+  explicit cow_flat_set(const key_compare& comp) : impl_{comp} {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  cow_flat_set(I f, I l, const key_compare& comp = key_compare())
+      : impl_{comp, detail::cow_ptr<sorted_type>::make(f, l, comp)} {}
+
+  cow_flat_set(std::initializer_list<value_type> il,
+               const key_compare& comp = key_compare())
+      : cow_flat_set(il.begin(), il.end(), comp) {}
+
+  explicit cow_flat_set(sorted_type x)
+      : impl_{x.value_comp(),
+              detail::cow_ptr<sorted_type>::make(std::move(x))} {}
+
+  cow_flat_set(const cow_flat_set&) = default;
+  cow_flat_set(cow_flat_set&&) = default;
+  cow_flat_set& operator=(const cow_flat_set&) = default;
+  cow_flat_set& operator=(cow_flat_set&&) = default;
+
+  ~cow_flat_set() = default;
+
+  //---------------------------------------------------------------------------
+  // Sharing.
+
+  // Makes sure that the set is not shared: copies it, if it is.
+  // Does nothing for a set that is not shared already.
+  void unshare() {
+    if (!impl_.body_) {
+      impl_.body_ = detail::cow_ptr<sorted_type>::make(value_comp());
+    } else if (!impl_.body_.unique()) {
+      impl_.body_ = detail::cow_ptr<sorted_type>::make(*impl_.body_);
+    }
+  }
+
+  bool is_shared() const {
+    return impl_.body_ && !impl_.body_.unique();
+  }
+
+  //---------------------------------------------------------------------------
+  // Size management.
+
+  size_type size() const { return set().size(); }
+  bool empty() const { return set().empty(); }
+
+  void clear() {
+    // No need to copy elements only to destroy them.
+    if (is_shared())
+      impl_.body_.reset();
+    else if (impl_.body_)
+      impl_.body_->clear();
+  }
+
+  //---------------------------------------------------------------------------
+  // Iterators. Do not detach.
+
+  const_iterator begin() const { return set().begin(); }
+  const_iterator cbegin() const { return begin(); }
+
+  const_iterator end() const { return set().end(); }
+  const_iterator cend() const { return end(); }
+
+  const_reverse_iterator rbegin() const { return set().rbegin(); }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+
+  const_reverse_iterator rend() const { return set().rend(); }
+  const_reverse_iterator crend() const { return rend(); }
+
+  //---------------------------------------------------------------------------
+  // Insert operations. Detach, even if nothing is inserted.
+
+  template <typename V>
+  std::pair<const_iterator, bool> insert(V&& v) {
+    return mutable_set().insert(std::forward<V>(v));
+  }
+
+  template <typename I>
+  // requires InputIterator<I>
+  void insert(I f, I l) {
+    mutable_set().insert(f, l);
+  }
+
+  template <typename... Args>
+  std::pair<const_iterator, bool> emplace(Args&&... args) {
+    return mutable_set().emplace(std::forward<Args>(args)...);
+  }
+
+  // --------------------------------------------------------------------------
+  // Erase operations. Detach only if there is something to erase.
+
+  template <typename V>
+  size_type erase(const V& v) {
+    if (!count(v))
+      return 0;
+    return mutable_set().erase(v);
+  }
+
+  const_iterator erase(const_iterator pos) {
+    auto offset = std::distance(begin(), pos);
+    sorted_type& s = mutable_set();
+    return s.erase(s.begin() + offset);
+  }
+
+  // --------------------------------------------------------------------------
+  // Search operations. Do not detach.
+
+  template <typename V>
+  size_type count(const V& v) const {
+    return set().count(v);
+  }
+
+  template <typename V>
+  const_iterator find(const V& v) const {
+    return set().find(v);
+  }
+
+  template <typename V>
+  std::pair<const_iterator, const_iterator> equal_range(const V& v) const {
+    return set().equal_range(v);
+  }
+
+  template <typename V>
+  const_iterator lower_bound(const V& v) const {
+    return set().lower_bound(v);
+  }
+
+  template <typename V>
+  const_iterator upper_bound(const V& v) const {
+    return set().upper_bound(v);
+  }
+
+  //---------------------------------------------------------------------------
+  // Getters.
+
+  key_compare key_comp() const { return impl_; }
+  value_compare value_comp() const { return impl_; }
+
+  const sorted_type& sorted() const { return set(); }
+  const underlying_type& body() const { return set().body(); }
+
+  //---------------------------------------------------------------------------
+  // General operations.
+
+  void swap(cow_flat_set& x) { impl_.body_.swap(x.impl_.body_); }
+
+  friend void swap(cow_flat_set& x, cow_flat_set& y) { x.swap(y); }
+
+  // Copies of the same set compare equal without looking at the elements.
+  friend bool operator==(const cow_flat_set& x, const cow_flat_set& y) {
+    return x.impl_.body_ == y.impl_.body_ || x.set() == y.set();
+  }
+
+  friend bool operator!=(const cow_flat_set& x, const cow_flat_set& y) {
+    return !(x == y);
+  }
+};
+
+}  // namespace lib
@@ -0,0 +1,98 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cow_flat_set.h"
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kLookupsPerRequest = 10;
+constexpr int kRequests = 1000;
+
+// Too long for the small string optimization: copies allocate.
+std::string make_key(int i) {
+  return "configuration_key_" + std::to_string(i);
+}
+
+struct input_t {
+  std::vector<std::string> set;
+  std::vector<std::string> lookups;
+};
+
+const input_t& input(size_t size) {
+  static std::vector<input_t> cache(1 << 20);
+  input_t& res = cache[size];
+  if (!res.set.empty())
+    return res;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, static_cast<int>(2 * size));
+  for (size_t i = 0; i < size; ++i)
+    res.set.push_back(make_key(static_cast<int>(2 * i)));
+  for (int i = 0; i < kRequests * kLookupsPerRequest; ++i)
+    res.lookups.push_back(make_key(dis(g)));
+  return res;
+}
+
+// Every request copies the set, does a few lookups and, once in
+// state.range(1) requests, inserts an element into its copy.
+template <typename Set>
+void copy_per_request(benchmark::State& state) {
+  const input_t& in = input(static_cast<size_t>(state.range(0)));
+  const int mutate_every = static_cast<int>(state.range(1));
+  const Set c(in.set.begin(), in.set.end());
+
+  for (auto _ : state) {
+    auto lookup = in.lookups.begin();
+    for (int request = 0; request < kRequests; ++request) {
+      Set copy = c;
+      for (int i = 0; i < kLookupsPerRequest; ++i)
+        benchmark::DoNotOptimize(copy.count(*lookup++));
+      if (mutate_every && request % mutate_every == 0)
+        copy.insert(*in.lookups.begin());
+      benchmark::DoNotOptimize(copy);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kRequests);
+}
+
+// Lookups without copies: the cost of going through the shared pointer.
+template <typename Set>
+void lookups_only(benchmark::State& state) {
+  const input_t& in = input(static_cast<size_t>(state.range(0)));
+  const Set c(in.set.begin(), in.set.end());
+
+  for (auto _ : state) {
+    for (const auto& key : in.lookups)
+      benchmark::DoNotOptimize(c.count(key));
+  }
+  state.SetItemsProcessed(state.iterations() * in.lookups.size());
+}
+
+void copy_args(benchmark::internal::Benchmark* bench) {
+  for (int size : {100, 10000}) {
+    for (int mutate_every : {0, 100, 10, 1})
+      bench->Args({size, mutate_every});
+  }
+}
+
+void lookup_args(benchmark::internal::Benchmark* bench) {
+  for (int size : {100, 10000})
+    bench->Arg(size);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(copy_per_request, lib::flat_set<std::string>)
+    ->Apply(copy_args);
+BENCHMARK_TEMPLATE(copy_per_request, lib::cow_flat_set<std::string>)
+    ->Apply(copy_args);
+BENCHMARK_TEMPLATE(lookups_only, lib::flat_set<std::string>)
+    ->Apply(lookup_args);
+BENCHMARK_TEMPLATE(lookups_only, lib::cow_flat_set<std::string>)
+    ->Apply(lookup_args);
+
+BENCHMARK_MAIN();
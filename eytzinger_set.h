@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+#include "lib.h"
+
+namespace lib {
+
+namespace detail {
+
+// Eytzinger layout is an implicit binary search tree, stored in BFS order.
+// Nodes are numbered from 1, children of k are 2k and 2k + 1. 0 is used as
+// past the end.
+
+inline size_t eytzinger_first(size_t n) {
+  if (!n)
+    return 0;
+  size_t k = 1;
+  while (2 * k <= n)
+    k = 2 * k;
+  return k;
+}
+
+inline size_t eytzinger_last(size_t n) {
+  if (!n)
+    return 0;
+  size_t k = 1;
+  while (2 * k + 1 <= n)
+    k = 2 * k + 1;
+  return k;
+}
+
+// In order successor. The root is odd, so going up from the rightmost path
+// ends up at 0.
+inline size_t eytzinger_next(size_t k, size_t n) {
+  if (2 * k + 1 <= n) {
+    k = 2 * k + 1;
+    while (2 * k <= n)
+      k = 2 * k;
+    return k;
+  }
+  while (k & 1)
+    k >>= 1;
+  return k >> 1;
+}
+
+inline size_t eytzinger_prev(size_t k, size_t n) {
+  if (!k)
+    return eytzinger_last(n);
+  if (2 * k <= n) {
+    k = 2 * k;
+    while (2 * k + 1 <= n)
+      k = 2 * k + 1;
+    return k;
+  }
+  while (!(k & 1))
+    k >>= 1;
+  return k >> 1;
+}
+
+// Descends the tree without branching on the comparison result. At the end
+// k encodes the path: every 1 is a turn right. The answer is the node where
+// we turned left for the last time.
+//
+// The descendants of k log2(kBlock) levels down are kBlock nodes in a row,
+// [k * kBlock, (k + 1) * kBlock), one cache line worth of bytes. The vector
+// does not align them to a line, so usually they span two: both are
+// prefetched that many steps before we need them.
+template <typename T, typename P>
+// requires UnaryPredicate<P, T>
+size_t eytzinger_partition_point(const T* data, size_t n, P p) {
+  constexpr size_t kBlock =
+      sizeof(T) < kCacheLineSize ? kCacheLineSize / sizeof(T) : 1;
+
+  size_t k = 1;
+  while (k <= n) {
+    __builtin_prefetch(data + std::min(k * kBlock, n) - 1);
+    __builtin_prefetch(data + std::min((k + 1) * kBlock - 1, n) - 1);
+    k = 2 * k + static_cast<size_t>(p(data[k - 1]));
+  }
+  k >>= __builtin_ctzll(~static_cast<unsigned long long>(k)) + 1;
+  return k;
+}
+
+template <typename T>
+class eytzinger_iterator {
+ public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+  using reference = const T&;
+  using pointer = const T*;
+
+  eytzinger_iterator() = default;
+  eytzinger_iterator(const T* data, size_t size, size_t k)
+      : data_(data), size_(size), k_(k) {}
+
+  size_t index() const { return k_; }
+
+  reference operator*() const { return data_[k_ - 1]; }
+  pointer operator->() const { return data_ + k_ - 1; }
+
+  eytzinger_iterator& operator++() {
+    k_ = eytzinger_next(k_, size_);
+    return *this;
+  }
+
+  eytzinger_iterator operator++(int) {
+    auto res = *this;
+    ++*this;
+    return res;
+  }
+
+  eytzinger_iterator& operator--() {
+    k_ = eytzinger_prev(k_, size_);
+    return *this;
+  }
+
+  eytzinger_iterator operator--(int) {
+    auto res = *this;
+    --*this;
+    return res;
+  }
+
+  friend bool operator==(const eytzinger_iterator& x,
+                         const eytzinger_iterator& y) {
+    return x.k_ == y.k_;
+  }
+
+  friend bool operator!=(const eytzinger_iterator& x,
+                         const eytzinger_iterator& y) {
+    return !(x == y);
+  }
+
+ private:
+  const T* data_ = nullptr;
+  size_t size_ = 0;
+  size_t k_ = 0;
+};
+
+}  // namespace detail
+
+// Read only set that stores keys in the Eytzinger (BFS) order.
+// The top levels of the tree share cache lines and the search prefetches the
+// lines for several levels ahead, so for big sets it does much better than
+// std::lower_bound. Iteration is still in the sorted order but is not
+// contiguous in memory.
+template <typename Key,
+          typename Comparator = less,
+          typename UnderlyingType = std::vector<Key>>
+// requires (todo)
+class eytzinger_set {
+ public:
+  using underlying_type = UnderlyingType;
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = typename underlying_type::size_type;
+  using difference_type = std::ptrdiff_t;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+  using reference = typename underlying_type::const_reference;
+  using const_reference = typename underlying_type::const_reference;
+  using iterator = detail::eytzinger_iterator<value_type>;
+  using const_iterator = iterator;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = reverse_iterator;
+
+ private:
+  struct impl_t : value_compare {
+    impl_t() = default;
+
+    explicit impl_t(value_compare comp) : value_compare(comp) {}
+
+    underlying_type body_;
+  }
+  impl_;
+
+  template <typename V>
+  using type_for_value_compare =
+      typename std::conditional<TransparentComparator<value_compare>(),
+                                V,
+                                value_type>::type;
+
+  const_iterator make_iterator(size_t k) const {
+    return {body().data(), size(), k};
+  }
+
+  // Expects sorted and unique input.
+  void layout(underlying_type& sorted) {
+    body().resize(sorted.size());
+    size_t k = detail::eytzinger_first(size());
+    for (auto& x : sorted) {
+      body()[k - 1] = std::move(x);
+      k = detail::eytzinger_next(k, size());
+    }
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  eytzinger_set() = default;
+  explicit eytzinger_set(const key_compare& comp) : impl_{comp} {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  eytzinger_set(I f, I l, const key_compare& comp = key_compare())
+      : impl_{comp} {
+    underlying_type sorted(f, l);
+    sorted.erase(sort_and_unique(sorted.begin(), sorted.end(), value_comp()),
+                 sorted.end());
+    layout(sorted);
+  }
+
+  // Freezes the flat_set, it is already sorted.
+  template <typename... Ts>
+  explicit eytzinger_set(const flat_set<Key, Comparator, Ts...>& x)
+      : impl_{x.key_comp()} {
+    underlying_type sorted(x.begin(), x.end());
+    layout(sorted);
+  }
+
+  eytzinger_set(std::initializer_list<value_type> il,
+                const key_compare& comp = key_compare())
+      : eytzinger_set(il.begin(), il.end(), comp) {}
+
+  eytzinger_set(const eytzinger_set&) = default;
+  eytzinger_set(eytzinger_set&&) = default;
+  eytzinger_set& operator=(const eytzinger_set&) = default;
+  eytzinger_set& operator=(eytzinger_set&&) = default;
+
+  ~eytzinger_set() = default;
+
+  //---------------------------------------------------------------------------
+  // Size management.
+
+  size_type size() const { return body().size(); }
+  bool empty() const { return body().empty(); }
+
+  //---------------------------------------------------------------------------
+  // Iterators.
+
+  const_iterator begin() const {
+    return make_iterator(detail::eytzinger_first(size()));
+  }
+  const_iterator cbegin() const { return begin(); }
+
+  const_iterator end() const { return make_iterator(0); }
+  const_iterator cend() const { return end(); }
+
+  const_reverse_iterator rbegin() const { return reverse_iterator(end()); }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+
+  const_reverse_iterator rend() const { return reverse_iterator(begin()); }
+  const_reverse_iterator crend() const { return rend(); }
+
+  // --------------------------------------------------------------------------
+  // Search operations.
+
+  template <typename V>
+  size_type count(const V& v) const {
+    return find(v) == end() ? 0 : 1;
+  }
+
+  template <typename V>
+  const_iterator find(const V& v) const {
+    auto pos = lower_bound(v);
+    if (pos == end() || value_comp()(v, *pos))
+      return end();
+    return pos;
+  }
+
+  template <typename V>
+  std::pair<const_iterator, const_iterator> equal_range(const V& v) const {
+    auto pos = lower_bound(v);
+    if (pos == end() || value_comp()(v, *pos))
+      return {pos, pos};
+
+    return {pos, std::next(pos)};
+  }
+
+  template <typename V>
+  const_iterator lower_bound(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    auto comp = value_comp();
+    return make_iterator(detail::eytzinger_partition_point(
+        body().data(), size(),
+        [&](const_reference x) { return comp(x, v_ref); }));
+  }
+
+  template <typename V>
+  const_iterator upper_bound(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    auto comp = value_comp();
+    return make_iterator(detail::eytzinger_partition_point(
+        body().data(), size(),
+        [&](const_reference x) { return !comp(v_ref, x); }));
+  }
+
+  //---------------------------------------------------------------------------
+  // Getters.
+
+  key_compare key_comp() const { return impl_; }
+  value_compare value_comp() const { return impl_; }
+
+  // Elements in the Eytzinger order.
+  const underlying_type& body() const { return impl_.body_; }
+
+  //---------------------------------------------------------------------------
+  // General operations.
+
+  void swap(eytzinger_set& x) { impl_.body_.swap(x.impl_.body_); }
+
+  friend void swap(eytzinger_set& x, eytzinger_set& y) { x.swap(y); }
+
+  friend bool operator==(const eytzinger_set& x, const eytzinger_set& y) {
+    return x.body() == y.body();
+  }
+
+  friend bool operator!=(const eytzinger_set& x, const eytzinger_set& y) {
+    return !(x == y);
+  }
+
+ private:
+  underlying_type& body() { return impl_.body_; }
+};
+
+}  // namespace lib
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kSetSize = 1'000'000;
+
+using int_vec = std::vector<int>;
+
+const lib::flat_set<int>& test_set() {
+  static const lib::flat_set<int> res = [] {
+    int_vec v(kSetSize);
+    std::iota(v.begin(), v.end(), 0);
+    // Only even numbers, so that half of the lookups fail.
+    for (int& x : v)
+      x *= 2;
+    return lib::flat_set<int>(std::move(v));
+  }();
+  return res;
+}
+
+int_vec sorted_queries(size_t batch_size) {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 2 * kSetSize);
+  int_vec res(batch_size);
+  std::generate(res.begin(), res.end(), [&] { return dis(g); });
+  std::sort(res.begin(), res.end());
+  return res;
+}
+
+void batch_sizes(benchmark::internal::Benchmark* bench) {
+  bench->RangeMultiplier(8)->Range(8, 1 << 18);
+}
+
+void repeated_lower_bound(benchmark::State& state) {
+  const auto& c = test_set();
+  auto queries = sorted_queries(static_cast<size_t>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    for (int q : queries)
+      benchmark::DoNotOptimize(c.lower_bound(q));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void finger_search(benchmark::State& state) {
+  const auto& c = test_set();
+  auto queries = sorted_queries(static_cast<size_t>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    auto searcher = c.searcher();
+    for (int q : queries)
+      benchmark::DoNotOptimize(searcher.lower_bound(q));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}  // namespace
+
+BENCHMARK(repeated_lower_bound)->Apply(batch_sizes);
+BENCHMARK(finger_search)->Apply(batch_sizes);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_view.hpp>
+
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr size_t kSetSize = 1000;
+constexpr size_t kQueries = 10000;
+constexpr int kHitPercent = 90;
+
+// Too long for the small string optimization: every std::string allocates.
+std::string make_key(int i) {
+  return "some_long_key_prefix_" + std::to_string(i);
+}
+
+struct input_t {
+  lib::flat_set<std::string> set;
+  std::vector<std::string> queries;
+};
+
+const input_t& input() {
+  static const input_t res = [] {
+    input_t res;
+    for (int i = 0; i < static_cast<int>(kSetSize); ++i)
+      res.set.insert(make_key(2 * i));
+
+    std::mt19937 g;
+    std::uniform_int_distribution<> percent(0, 99);
+    std::uniform_int_distribution<> key(0, static_cast<int>(kSetSize) - 1);
+    for (size_t i = 0; i < kQueries; ++i) {
+      const bool hit = percent(g) < kHitPercent;
+      res.queries.push_back(make_key(2 * key(g) + (hit ? 0 : 1)));
+    }
+    return res;
+  }();
+  return res;
+}
+
+// What insert(string_view) had to be before: construct, then search.
+void insert_value_type(benchmark::State& state) {
+  const input_t& in = input();
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto c = in.set;
+    state.ResumeTiming();
+
+    for (const auto& q : in.queries)
+      c.insert(std::string(boost::string_view(q)));
+    benchmark::DoNotOptimize(c);
+  }
+}
+
+void insert_heterogeneous(benchmark::State& state) {
+  const input_t& in = input();
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto c = in.set;
+    state.ResumeTiming();
+
+    for (const auto& q : in.queries)
+      c.insert(boost::string_view(q));
+    benchmark::DoNotOptimize(c);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(insert_value_type);
+BENCHMARK(insert_heterogeneous);
+
+BENCHMARK_MAIN();
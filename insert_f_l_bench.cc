@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <numeric>
 #include <random>
 #include <map>
 
@@ -11,6 +14,35 @@
 
 #include "benchmark/benchmark.h"
 
+// Counts live heap bytes, so that benchmarks can report the peak.
+namespace {
+
+size_t live_bytes = 0;
+size_t peak_bytes = 0;
+
+// Enough to keep the alignment of operator new.
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  void* res = std::malloc(size + kHeader);
+  if (!res)
+    throw std::bad_alloc();
+  *static_cast<size_t*>(res) = size;
+  live_bytes += size;
+  peak_bytes = std::max(peak_bytes, live_bytes);
+  return static_cast<char*>(res) + kHeader;
+}
+
+void operator delete(void* ptr) noexcept {
+  if (!ptr)
+    return;
+  void* header = static_cast<char*>(ptr) - kHeader;
+  live_bytes -= *static_cast<size_t*>(header);
+  std::free(header);
+}
+
 namespace {
 
 constexpr size_t kLhsSize = 1000;
@@ -92,6 +124,32 @@ void Sentinal(benchmark::State& state) {
 }
 BENCHMARK(Sentinal)->Apply(set_input_sizes);
 
+// Both sides are flat_sets: insert(f, l) vs merge.
+template <bool use_merge>
+void flat_set_union_bench(benchmark::State& state) {
+  auto input = test_input_data(state.range(0));
+  lib::flat_set<int> c(input.first->begin(), input.first->end());
+  const lib::flat_set<int> x(input.second->begin(), input.second->end());
+  while (state.KeepRunning()) {
+    auto copy = c;
+    copy.reserve(c.size() + x.size());
+    if (use_merge)
+      copy.merge(x);
+    else
+      copy.insert(x.begin(), x.end());
+  }
+}
+
+void SentinalInsertSet(benchmark::State& state) {
+  flat_set_union_bench<false>(state);
+}
+BENCHMARK(SentinalInsertSet)->Apply(set_input_sizes);
+
+void SentinalMerge(benchmark::State& state) {
+  flat_set_union_bench<true>(state);
+}
+BENCHMARK(SentinalMerge)->Apply(set_input_sizes);
+
 void Boost(benchmark::State& state) {
   insert_first_last_bench<boost::container::flat_set<int>>(state);
 }
@@ -102,6 +160,75 @@ void Folly(benchmark::State& state) {
 }
 BENCHMARK(Folly)->Apply(set_input_sizes);
 
+// Big sets: time and peak memory of insert vs insert_in_place.
+// peak_memory is the biggest amount of heap in use during the insert,
+// relative to the memory of the set before it.
+
+constexpr int kLargeLhsSize = 1 << 24;
+
+void large_input_sizes(benchmark::internal::Benchmark* bench) {
+  for (int rhs : {kLargeLhsSize / 16, kLargeLhsSize / 2})
+    bench->Args({kLargeLhsSize, rhs});
+  bench->Unit(benchmark::kMillisecond);
+}
+
+struct regular_insert {
+  template <typename I>
+  void operator()(lib::flat_set<int>& c, I f, I l) {
+    c.insert(f, l);
+  }
+};
+
+struct in_place_insert {
+  template <typename I>
+  void operator()(lib::flat_set<int>& c, I f, I l) {
+    c.insert_in_place(f, l);
+  }
+};
+
+template <typename Insert>
+void large_insert_bench(benchmark::State& state) {
+  int_vec already_in(static_cast<size_t>(state.range(0)));
+  std::iota(already_in.begin(), already_in.end(), 0);
+  std::transform(already_in.begin(), already_in.end(), already_in.begin(),
+                 [](int x) { return x * 2; });
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, state.range(0) * 2);
+  int_vec inserting(static_cast<size_t>(state.range(1)));
+  std::generate(inserting.begin(), inserting.end(), [&] { return dis(g); });
+
+  const double orig_bytes =
+      static_cast<double>(already_in.size() * sizeof(int));
+  double peak = 0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    lib::flat_set<int> c(lib::sorted_unique, already_in);
+    peak_bytes = live_bytes;
+    const size_t before = live_bytes - already_in.size() * sizeof(int);
+    state.ResumeTiming();
+
+    Insert{}(c, inserting.begin(), inserting.end());
+
+    state.PauseTiming();
+    peak = std::max(peak, static_cast<double>(peak_bytes - before));
+    state.ResumeTiming();
+  }
+
+  state.counters["peak_memory"] = peak / orig_bytes;
+}
+
+void LargeInsert(benchmark::State& state) {
+  large_insert_bench<regular_insert>(state);
+}
+BENCHMARK(LargeInsert)->Apply(large_input_sizes);
+
+void LargeInsertInPlace(benchmark::State& state) {
+  large_insert_bench<in_place_insert>(state);
+}
+BENCHMARK(LargeInsertInPlace)->Apply(large_input_sizes);
+
 }  // namespace
 
 BENCHMARK_MAIN();
@@ -0,0 +1,459 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lib.h"
+
+namespace lib {
+
+namespace detail {
+
+// Element of a leveled_flat_set level. An erased entry (tombstone) hides
+// the same key in all older levels.
+template <typename Key>
+struct leveled_entry {
+  Key key;
+  bool erased;
+};
+
+template <typename Comparator>
+struct leveled_entry_compare : Comparator {
+  leveled_entry_compare() = default;
+  explicit leveled_entry_compare(const Comparator& comp) : Comparator(comp) {}
+
+  template <typename Key>
+  bool operator()(const leveled_entry<Key>& x,
+                  const leveled_entry<Key>& y) const {
+    Comparator comp = *this;
+    return comp(x.key, y.key);
+  }
+};
+
+// Merges the levels on the fly: among the entries with the smallest key the
+// newest one wins, keys whose newest entry is a tombstone are skipped.
+// A compacted set has one level, so this is a plain walk over it.
+template <typename Key, typename Comparator>
+class leveled_iterator {
+  using entry = leveled_entry<Key>;
+  // [first, last) of a level.
+  using cursor = std::pair<const entry*, const entry*>;
+
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using reference = const Key&;
+  using pointer = const Key*;
+
+  leveled_iterator() = default;
+
+  // levels are ordered from the newest to the oldest.
+  leveled_iterator(const std::vector<std::vector<entry>>& levels,
+                   Comparator comp)
+      : comp_(comp) {
+    for (const auto& l : levels) {
+      if (!l.empty())
+        cursors_.emplace_back(l.data(), l.data() + l.size());
+    }
+    settle();
+  }
+
+  reference operator*() const { return current_->key; }
+  pointer operator->() const { return &current_->key; }
+
+  leveled_iterator& operator++() {
+    skip(current_->key);
+    settle();
+    return *this;
+  }
+
+  leveled_iterator operator++(int) {
+    auto res = *this;
+    ++*this;
+    return res;
+  }
+
+  // Every position has its own entry, end has none.
+  friend bool operator==(const leveled_iterator& x,
+                         const leveled_iterator& y) {
+    return x.current_ == y.current_;
+  }
+
+  friend bool operator!=(const leveled_iterator& x,
+                         const leveled_iterator& y) {
+    return !(x == y);
+  }
+
+ private:
+  // Moves all of the cursors past key, which is the smallest one.
+  void skip(const Key& key) {
+    Comparator comp = comp_;
+    for (auto& c : cursors_) {
+      if (c.first != c.second && !comp(key, c.first->key))
+        ++c.first;
+    }
+  }
+
+  void settle() {
+    Comparator comp = comp_;
+    while (true) {
+      current_ = nullptr;
+      // Strictly less: on equal keys the newer level stays.
+      for (const auto& c : cursors_) {
+        if (c.first != c.second &&
+            (!current_ || comp(c.first->key, current_->key)))
+          current_ = c.first;
+      }
+      if (!current_ || !current_->erased)
+        return;
+      skip(current_->key);
+    }
+  }
+
+  std::vector<cursor> cursors_;
+  const entry* current_ = nullptr;
+  Comparator comp_;
+};
+
+}  // namespace detail
+
+// Set for a lot of inserts and erases into a big set, in the spirit of the
+// log-structured merge tree.
+// Elements live in sorted levels, level i holds up to
+// kFirstLevelSize * kGrowthFactor^i elements. Inserts go into the first
+// level. When a level is full, it is merged into the next one with
+// set_union_unbalanced, which is good at merging a small range into a big one.
+// Erase writes a tombstone into the first level, tombstones are dropped when
+// they are merged into the last level.
+//
+// Lookups search the levels from the newest to the oldest, so they cost
+// O(log(n) * number of levels).
+//
+// Iteration merges the levels on the fly and does not change the set, so
+// const member functions are safe to call from many threads at once.
+// compact() merges everything into one level explicitly, after that
+// iteration is a walk over one sorted vector.
+template <typename Key, typename Comparator = less>
+// requires (todo)
+class leveled_flat_set {
+  using entry = detail::leveled_entry<Key>;
+  using level = std::vector<entry>;
+  using entry_compare = detail::leveled_entry_compare<Comparator>;
+
+ public:
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+  using reference = const value_type&;
+  using const_reference = const value_type&;
+  using iterator = detail::leveled_iterator<Key, Comparator>;
+  using const_iterator = iterator;
+
+  static constexpr size_type kFirstLevelSize = 256;
+  static constexpr size_type kGrowthFactor = 8;
+
+ private:
+  struct impl_t : entry_compare {
+    impl_t() = default;
+
+    explicit impl_t(const value_compare& comp) : entry_compare(comp) {}
+
+    // Newest level first.
+    std::vector<level> levels_;
+    size_type size_ = 0;
+  };
+  impl_t impl_;
+
+  template <typename V>
+  using type_for_value_compare =
+      typename std::conditional<TransparentComparator<value_compare>(),
+                                V,
+                                value_type>::type;
+
+  std::vector<level>& levels() { return impl_.levels_; }
+  const std::vector<level>& levels() const { return impl_.levels_; }
+
+  static size_type level_capacity(size_type i) {
+    size_type res = kFirstLevelSize;
+    while (i--)
+      res *= kGrowthFactor;
+    return res;
+  }
+
+  // Levels that fit in cache are searched branchless: a lookup usually misses
+  // most of them, so the branches are not predictable. For the big ones
+  // speculating on a branch hides some of the cache misses.
+  static constexpr size_type kBranchlessSearchLimit = 1 << 16;
+
+  template <typename V>
+  typename level::const_iterator lower_bound_in(const level& l,
+                                                const V& v) const {
+    auto comp = value_comp();
+    auto less_than_v = [&](const entry& x, const V& y) {
+      return comp(x.key, y);
+    };
+    if (l.size() <= kBranchlessSearchLimit)
+      return lower_bound_branchless(l.begin(), l.end(), v, less_than_v);
+    return std::lower_bound(l.begin(), l.end(), v, less_than_v);
+  }
+
+  // Newest entry for v, nullptr if there is none.
+  template <typename V>
+  const entry* find_entry(const V& v) const {
+    for (const level& l : levels()) {
+      auto pos = lower_bound_in(l, v);
+      if (pos != l.end() && !value_comp()(v, pos->key))
+        return &*pos;
+    }
+    return nullptr;
+  }
+
+  // Puts x in the first level, replacing an entry with the same key.
+  void write(entry x) {
+    if (levels().empty())
+      levels().emplace_back();
+    level& first = levels().front();
+
+    auto pos = first.begin() + (lower_bound_in(first, x.key) - first.cbegin());
+    if (pos != first.end() && !value_comp()(x.key, pos->key))
+      *pos = std::move(x);
+    else
+      first.insert(pos, std::move(x));
+
+    if (first.size() >= kFirstLevelSize)
+      merge_levels_from(0);
+  }
+
+  void merge_levels_from(size_type i) {
+    for (; levels()[i].size() >= level_capacity(i); ++i) {
+      if (i + 1 == levels().size())
+        levels().emplace_back();
+      merge_into_next(i);
+    }
+  }
+
+  // Entries from levels()[i] win over the ones with the same key in
+  // levels()[i + 1]: set_union copies equal elements from the first range.
+  void merge_into_next(size_type i) {
+    level& newer = levels()[i];
+    level& older = levels()[i + 1];
+
+    if (newer.empty())
+      return;
+
+    if (older.empty()) {
+      older.swap(newer);
+    } else {
+      level merged;
+      merged.reserve(newer.size() + older.size());
+      set_union_unbalanced(std::make_move_iterator(newer.begin()),
+                           std::make_move_iterator(newer.end()),
+                           std::make_move_iterator(older.begin()),
+                           std::make_move_iterator(older.end()),
+                           std::back_inserter(merged),
+                           static_cast<const entry_compare&>(impl_));
+      older.swap(merged);
+      newer.clear();
+    }
+
+    // Nothing older to hide.
+    if (i + 2 == levels().size()) {
+      older.erase(std::remove_if(older.begin(), older.end(),
+                                 [](const entry& x) { return x.erased; }),
+                  older.end());
+    }
+  }
+
+  void assign_sorted(std::vector<value_type> sorted) {
+    levels().clear();
+    impl_.size_ = sorted.size();
+    if (sorted.empty())
+      return;
+
+    size_type i = 0;
+    while (level_capacity(i) <= sorted.size())
+      ++i;
+    levels().resize(i + 1);
+    level& last = levels().back();
+    last.reserve(sorted.size());
+    for (auto& x : sorted)
+      last.push_back(entry{std::move(x), false});
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  leveled_flat_set() = default;
+  explicit leveled_flat_set(const key_compare& comp) : impl_{comp} {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  leveled_flat_set(I f, I l, const key_compare& comp = key_compare())
+      : impl_{comp} {
+    std::vector<value_type> sorted(f, l);
+    sorted.erase(sort_and_unique(sorted.begin(), sorted.end(), value_comp()),
+                 sorted.end());
+    assign_sorted(std::move(sorted));
+  }
+
+  leveled_flat_set(std::initializer_list<value_type> il,
+                   const key_compare& comp = key_compare())
+      : leveled_flat_set(il.begin(), il.end(), comp) {}
+
+  leveled_flat_set(const leveled_flat_set&) = default;
+  leveled_flat_set(leveled_flat_set&&) = default;
+  leveled_flat_set& operator=(const leveled_flat_set&) = default;
+  leveled_flat_set& operator=(leveled_flat_set&&) = default;
+
+  ~leveled_flat_set() = default;
+
+  //---------------------------------------------------------------------------
+  // Size management.
+
+  size_type size() const { return impl_.size_; }
+  bool empty() const { return !size(); }
+
+  // Number of non empty levels.
+  size_type level_count() const {
+    return static_cast<size_type>(
+        std::count_if(levels().begin(), levels().end(),
+                      [](const level& l) { return !l.empty(); }));
+  }
+
+  void clear() {
+    levels().clear();
+    impl_.size_ = 0;
+  }
+
+  //---------------------------------------------------------------------------
+  // Iterators. Do not compact the set.
+
+  const_iterator begin() const { return {levels(), value_comp()}; }
+  const_iterator cbegin() const { return begin(); }
+
+  const_iterator end() const { return {}; }
+  const_iterator cend() const { return end(); }
+
+  //---------------------------------------------------------------------------
+  // Insert operations.
+
+  // Returns false if v was already in the set.
+  template <typename V>
+  bool insert(V&& v) {
+    const type_for_value_compare<V>& v_ref = v;
+    const entry* found = find_entry(v_ref);
+    if (found && !found->erased)
+      return false;
+    write(entry{value_type(std::forward<V>(v)), false});
+    ++impl_.size_;
+    return true;
+  }
+
+  template <typename... Args>
+  bool emplace(Args&&... args) {
+    return insert(value_type(std::forward<Args>(args)...));
+  }
+
+  template <typename I>
+  // requires InputIterator<I>
+  void insert(I f, I l) {
+    for (; f != l; ++f)
+      insert(*f);
+  }
+
+  // --------------------------------------------------------------------------
+  // Erase operations.
+
+  template <typename V>
+  size_type erase(const V& v) {
+    const type_for_value_compare<V>& v_ref = v;
+    const entry* found = find_entry(v_ref);
+    if (!found || found->erased)
+      return 0;
+
+    --impl_.size_;
+    if (levels().size() == 1) {
+      level& only = levels().front();
+      only.erase(only.begin() + (found - only.data()));
+      return 1;
+    }
+
+    write(entry{found->key, true});
+    return 1;
+  }
+
+  // Merges all of the levels into one and drops the tombstones.
+  void compact() {
+    if (levels().empty())
+      return;
+    // Every level goes into the last one. Empty levels are kept, so the
+    // following inserts start from a small first level.
+    for (size_type i = 0; i + 1 < levels().size(); ++i)
+      merge_into_next(i);
+  }
+
+  // --------------------------------------------------------------------------
+  // Search operations. Do not compact the set.
+
+  template <typename V>
+  bool contains(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    const entry* found = find_entry(v_ref);
+    return found && !found->erased;
+  }
+
+  template <typename V>
+  size_type count(const V& v) const {
+    return contains(v) ? 1 : 0;
+  }
+
+  //---------------------------------------------------------------------------
+  // Getters.
+
+  key_compare key_comp() const { return impl_; }
+  value_compare value_comp() const { return impl_; }
+
+  //---------------------------------------------------------------------------
+  // General operations.
+
+  void swap(leveled_flat_set& x) {
+    impl_.levels_.swap(x.impl_.levels_);
+    std::swap(impl_.size_, x.impl_.size_);
+  }
+
+  friend void swap(leveled_flat_set& x, leveled_flat_set& y) { x.swap(y); }
+
+  friend bool operator==(const leveled_flat_set& x,
+                         const leveled_flat_set& y) {
+    return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend bool operator!=(const leveled_flat_set& x,
+                         const leveled_flat_set& y) {
+    return !(x == y);
+  }
+};
+
+template <typename Key, typename Comparator>
+constexpr typename leveled_flat_set<Key, Comparator>::size_type
+    leveled_flat_set<Key, Comparator>::kFirstLevelSize;
+
+template <typename Key, typename Comparator>
+constexpr typename leveled_flat_set<Key, Comparator>::size_type
+    leveled_flat_set<Key, Comparator>::kGrowthFactor;
+
+template <typename Key, typename Comparator>
+constexpr typename leveled_flat_set<Key, Comparator>::size_type
+    leveled_flat_set<Key, Comparator>::kBranchlessSearchLimit;
+
+}  // namespace lib
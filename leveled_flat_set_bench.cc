@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "leveled_flat_set.h"
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kOperations = 1 << 14;
+
+// The set is built from state.range(0) elements, then kOperations random
+// values are inserted or looked up. Half of them are in the set.
+struct input_t {
+  std::vector<int> initial;
+  std::vector<int> operations;
+};
+
+input_t make_input(int size) {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 2 * size);
+
+  input_t res;
+  res.initial.resize(static_cast<size_t>(size));
+  std::generate(res.initial.begin(), res.initial.end(), [&] { return dis(g); });
+  res.operations.resize(kOperations);
+  std::generate(res.operations.begin(), res.operations.end(),
+                [&] { return dis(g); });
+  return res;
+}
+
+template <typename Set>
+void insert(benchmark::State& state) {
+  const input_t in = make_input(static_cast<int>(state.range(0)));
+
+  // Declared outside of the loop, so the destructor runs while paused.
+  Set c;
+  for (auto _ : state) {
+    state.PauseTiming();
+    c = Set(in.initial.begin(), in.initial.end());
+    state.ResumeTiming();
+
+    for (int x : in.operations)
+      c.insert(x);
+    benchmark::DoNotOptimize(c);
+  }
+  state.SetItemsProcessed(state.iterations() * kOperations);
+}
+
+// The set is not compacted: lookups go through all of the levels.
+template <typename Set>
+void lookup(benchmark::State& state) {
+  const input_t in = make_input(static_cast<int>(state.range(0)));
+  Set c(in.initial.begin(), in.initial.end());
+  for (int x : in.operations)
+    c.insert(x + 1);
+
+  for (auto _ : state) {
+    for (int x : in.operations)
+      benchmark::DoNotOptimize(c.count(x));
+  }
+  state.SetItemsProcessed(state.iterations() * kOperations);
+}
+
+void set_sizes(benchmark::internal::Benchmark* bench) {
+  for (int size : {1 << 12, 1 << 16, 1 << 20, 1 << 24})
+    bench->Arg(size);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(insert, lib::flat_set<int>)->Apply(set_sizes);
+BENCHMARK_TEMPLATE(insert, lib::leveled_flat_set<int>)->Apply(set_sizes);
+BENCHMARK_TEMPLATE(lookup, lib::flat_set<int>)->Apply(set_sizes);
+BENCHMARK_TEMPLATE(lookup, lib::leveled_flat_set<int>)->Apply(set_sizes);
+
+BENCHMARK_MAIN();
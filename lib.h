@@ -1,13 +1,26 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <initializer_list>
 #include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 namespace lib {
 
 // meta functions -------------------------------------------------------------
@@ -146,6 +159,26 @@ typename std::enable_if
 >::type;
 // clang-format on
 
+// Insert of something that is not a value_type, but can be compared to it.
+// Not for arithmetic types: int(2.5) is not equivalent to 2.5.
+// clang-format off
+template <typename Comparator, typename ContainerValueType,
+          typename InsertedType>
+using heterogeneous_insert_should_be_enabled =
+typename std::enable_if
+<
+  has_is_transparent_member<Comparator>::value &&
+  !std::is_arithmetic<ContainerValueType>::value &&
+  !std::is_same<
+    ContainerValueType,
+    typename std::remove_cv<
+      typename std::remove_reference<InsertedType>::type
+    >::type
+  >::value &&
+  std::is_constructible<ContainerValueType, InsertedType&&>::value
+>::type;
+// clang-format on
+
 }  // namespace detail
 
 
@@ -178,27 +211,186 @@ detail::inverse_t<F> inverse_fn(F f) noexcept {
   return {f};
 }
 
+// tags -----------------------------------------------------------------------
+
+// The input is already sorted and has no duplicates, containers can skip
+// sort_and_unique. Checked by an assert.
+struct sorted_unique_t {
+  explicit sorted_unique_t() = default;
+};
+
+constexpr sorted_unique_t sorted_unique{};
+
+// Lets a container sort on up to num_threads threads. Without it containers
+// never start threads.
+struct parallel_t {
+  explicit parallel_t(size_t num_threads) : num_threads(num_threads) {}
+
+  size_t num_threads;
+};
+
+// The input is a range of ranges, each of them sorted and without
+// duplicates. Containers union them with set_union_n.
+struct sorted_unique_ranges_t {
+  explicit sorted_unique_ranges_t() = default;
+};
+
+constexpr sorted_unique_ranges_t sorted_unique_ranges{};
+
+namespace detail {
+
+template <typename P>
+struct is_less_than_operator : std::false_type {};
+
+template <>
+struct is_less_than_operator<less> : std::true_type {};
+
+template <>
+struct is_less_than_operator<std::less<>> : std::true_type {};
+
+template <typename T>
+struct is_less_than_operator<std::less<T>> : std::true_type {};
+
+template <typename I>
+struct is_contiguous_iterator
+    : std::integral_constant<
+          bool,
+          std::is_pointer<I>::value ||
+              std::is_same<I, typename std::vector<ValueType<I>>::iterator>::
+                  value ||
+              std::is_same<
+                  I,
+                  typename std::vector<ValueType<I>>::const_iterator>::value> {
+};
+
+template <>
+struct is_contiguous_iterator<std::vector<bool>::iterator> : std::false_type {};
+
+template <>
+struct is_contiguous_iterator<std::vector<bool>::const_iterator>
+    : std::false_type {};
+
+}  // namespace detail
+
 // algorithms -----------------------------------------------------------------
 
-// Think: stable_sort is a merge sort. Merge can be replaced with set_union ->
-// unique would not be required. Quick sort is not modified that easily (is it?)
-// to do this. How much does the unique matter? For the 1000 elements - log is
-// 10 - unique is 1 => 1/10? Measuring this would be cool.
+namespace detail {
 
 template <typename I, typename Comparator>
-// requires RandomAccessIterator<I>() && // It's possible to use Forward
-//                                       // but I would have to redo std::sort.
-//          StrictWeakOrdering<Comparator(ValueType<I>())>
-I sort_and_unique(I f, I l, Comparator comp) {
+I sort_and_unique_dispatch(I f, I l, Comparator comp, std::false_type) {
   std::sort(f, l, comp);
   return std::unique(f, l, not_fn(comp));
 }
 
-template <typename I>
-I sort_and_unique(I f, I l) {
-  return sort_and_unique(f, l, less{});
+template <typename I, typename Comparator>
+using use_radix_sort = std::integral_constant<
+    bool,
+    std::is_integral<ValueType<I>>::value &&
+        !std::is_same<ValueType<I>, bool>::value &&
+        is_less_than_operator<Comparator>::value &&
+        is_contiguous_iterator<I>::value>;
+
+// Maps integers to unsigned ones with the same order.
+template <typename T>
+typename std::make_unsigned<T>::type radix_key(T x) {
+  using U = typename std::make_unsigned<T>::type;
+  constexpr U kSignBit =
+      std::is_signed<T>::value ? U(1) << (sizeof(T) * 8 - 1) : U(0);
+  return static_cast<U>(x) ^ kSignBit;
+}
+
+inline size_t radix_byte(std::uint64_t key, size_t pass) {
+  return static_cast<size_t>((key >> (pass * 8)) & 0xFF);
+}
+
+// Byte-wise LSD radix sort of [f, l) with tmp as a buffer, followed by
+// unique. Histograms for all of the bytes are collected in one pass, bytes
+// that are the same for all elements are skipped.
+// Unique is done by the last scatter: elements come into each bucket in the
+// sorted order, so a duplicate is always equal to the last one written there.
+// Buckets are then compacted into [f, ...).
+template <typename T>
+T* radix_sort_and_unique(T* f, T* l, T* tmp) {
+  constexpr size_t kPasses = sizeof(T);
+  constexpr size_t kBuckets = 256;
+  const size_t size = static_cast<size_t>(l - f);
+
+  std::array<std::array<size_t, kBuckets>, kPasses> counts = {};
+  for (const T* it = f; it != l; ++it) {
+    auto key = radix_key(*it);
+    for (size_t pass = 0; pass < kPasses; ++pass)
+      ++counts[pass][radix_byte(key, pass)];
+  }
+
+  std::array<size_t, kPasses> passes;
+  size_t passes_size = 0;
+  for (size_t pass = 0; pass < kPasses; ++pass) {
+    if (counts[pass][radix_byte(radix_key(*f), pass)] != size)
+      passes[passes_size++] = pass;
+  }
+
+  // All elements are equal.
+  if (!passes_size)
+    return f + 1;
+
+  T* src = f;
+  T* dst = tmp;
+  std::array<size_t, kBuckets> starts;
+  std::array<size_t, kBuckets> positions;
+
+  for (size_t i = 0; i < passes_size; ++i) {
+    const size_t pass = passes[i];
+    std::partial_sum(counts[pass].begin(), counts[pass].end() - 1,
+                     starts.begin() + 1);
+    starts[0] = 0;
+    positions = starts;
+
+    if (i + 1 != passes_size) {
+      for (T* it = src; it != l; ++it)
+        dst[positions[radix_byte(radix_key(*it), pass)]++] = *it;
+      std::swap(src, dst);
+      l = src + size;
+      continue;
+    }
+
+    for (T* it = src; it != l; ++it) {
+      const size_t bucket = radix_byte(radix_key(*it), pass);
+      size_t& pos = positions[bucket];
+      if (pos != starts[bucket] && dst[pos - 1] == *it)
+        continue;
+      dst[pos++] = *it;
+    }
+  }
+
+  T* out = f;
+  for (size_t b = 0; b < kBuckets; ++b) {
+    T* bucket_f = dst + starts[b];
+    T* bucket_l = dst + positions[b];
+    if (out != bucket_f)
+      std::copy(bucket_f, bucket_l, out);
+    out += bucket_l - bucket_f;
+  }
+  return out;
+}
+
+// Below this many elements std::sort is faster: for random ints
+// radix is 1.1x faster at 512 elements, 1.2x at 1K and 5x at 4K.
+constexpr size_t kRadixSortThreshold = 512;
+
+template <typename I, typename Comparator>
+I sort_and_unique_dispatch(I f, I l, Comparator comp, std::true_type) {
+  const size_t size = static_cast<size_t>(l - f);
+  if (size < kRadixSortThreshold)
+    return sort_and_unique_dispatch(f, l, comp, std::false_type{});
+
+  using T = ValueType<I>;
+  std::vector<T> tmp(size);
+  T* data = &*f;
+  return f + (radix_sort_and_unique(data, data + size, tmp.data()) - data);
 }
 
+}  // namespace detail
+
 template <typename I>
 using DifferenceType = typename std::iterator_traits<I>::difference_type;
 
@@ -216,6 +408,10 @@ class partition_points_t {
   template <typename P>
   I operator()(P p);
 
+  // ++f() that keeps the sentinel in [f, l]. Searches only look at
+  // [f, l), so the callers are free to overwrite the elements before f.
+  void advance();
+
   I& f() { return f_; }
   I& l() { return l_; }
   I& f() const { return f_; }
@@ -242,6 +438,17 @@ void partition_points_t<I>::update_sentinel() {
   sent_ = std::next(f_, half);
 }
 
+template <typename I>
+void partition_points_t<I>::advance() {
+  if (f_ != sent_) {
+    ++f_;
+    return;
+  }
+  sent_ = ++f_;
+  --sent_to_l_;
+  update_sentinel();
+}
+
 template <typename I>
 template <typename P>
 inline
@@ -302,6 +509,75 @@ class lower_bounds_t : public partition_points_t<I>, P {
   }
 };
 
+// Answers lower_bound queries that mostly come in the ascending order.
+// Going forward it gallops from the previous answer, a jump back falls back
+// to the binary search in front of it.
+template <typename I, typename P = less>
+class finger_searcher {
+ public:
+  finger_searcher(I f, I l, P p = P{}) : f_(f), forward_(f, l, p), p_(p) {}
+
+  template <typename V>
+  I lower_bound(const V& v) {
+    I last = forward_.f();
+    if (last != f_ && !p_(*std::prev(last), v)) {
+      last = std::lower_bound(f_, last, v, p_);
+      forward_ = lower_bounds_t<I, P>(last, forward_.l(), p_);
+      return last;
+    }
+
+    if (last == forward_.l())
+      return last;
+    return forward_(v);
+  }
+
+  template <typename V>
+  I find(const V& v) {
+    I pos = lower_bound(v);
+    if (pos == forward_.l() || p_(v, *pos))
+      return forward_.l();
+    return pos;
+  }
+
+  template <typename V>
+  size_t count(const V& v) {
+    return find(v) == forward_.l() ? 0 : 1;
+  }
+
+ private:
+  I f_;
+  lower_bounds_t<I, P> forward_;
+  P p_;
+};
+
+// lower_bound that starts from a guess. The neighbours of the hint are
+// checked first, so a correct hint costs 1-2 comparisons. Otherwise it
+// gallops away from the hint: O(log(distance to the answer)).
+template <typename I, typename V, typename P>
+// requires BidirectionalIterator<I> && StrictWeakOrdering<P(ValueType<I>, V)>
+I lower_bound_hinted(I f, I hint, I l, const V& v, P p) {
+  auto less_than_v = [&](Reference<I> x) { return p(x, v); };
+
+  if (hint != l && less_than_v(*hint)) {
+    ++hint;
+    if (hint == l || !less_than_v(*hint))
+      return hint;
+    return partition_points_t<I>(hint, l)(less_than_v);
+  }
+
+  if (hint == f || less_than_v(*std::prev(hint)))
+    return hint;
+  --hint;
+  if (hint == f)
+    return hint;
+
+  using reverse_it = std::reverse_iterator<I>;
+  auto not_less_than_v = [&](Reference<I> x) { return !p(x, v); };
+  return partition_points_t<reverse_it>(reverse_it(hint), reverse_it(f))(
+             not_less_than_v)
+      .base();
+}
+
 namespace detail {
 
 template <typename I, typename P, typename V, typename O>
@@ -375,133 +651,1398 @@ O set_union_unbalanced(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
   return set_union_unbalanced(f1, l1, f2, l2, o, less{});
 }
 
+// Other set operations ------------------------------------------------------
+
+// Same galloping search as set_union_unbalanced. The loops report runs of
+// the elements from [f1, l1) that go to the output, so the in-place
+// flat_set members can share them.
+
 namespace detail {
 
-template <typename C, typename I, typename P>
-// requires  Container<C> &&  ForwardIterator<I> &&
-//           StrictWeakOrdering<P(ValueType<C>)>
-void insert_first_last_impl(C& c, I f, I l, P p) {
-  auto new_len = std::distance(f, l);
-  auto orig_len = c.size();
-  c.resize(orig_len + 2 * new_len);
+template <typename I1, typename I2, typename P, typename Emit>
+// requires ForwardIterator<I1> && ForwardIterator<I2> &&
+//          StrictWeakOrdering<P, ValueType<I>> && Emit(I1, I1)
+void set_intersection_unbalanced_impl(I1 f1, I1 l1, I2 f2, I2 l2, P p,
+                                      Emit emit) {
+  if (f1 == l1 || f2 == l2)
+    return;
 
-  Iterator<C> orig_f = c.begin();
-  Iterator<C> orig_l = c.begin() + orig_len;
-  Iterator<C> f_in = c.end() - new_len;
-  Iterator<C> l_in = c.end();
-  Iterator<C> buf = f_in;
+  lower_bounds_t<I1, P> lhs(f1, l1, p);
+  lower_bounds_t<I2, P> rhs(f2, l2, p);
+  while (true) {
+    lhs(*rhs.f());
+    if (lhs.f() == lhs.l())
+      return;
 
-  detail::copy(f, l, f_in);
-  l_in = sort_and_unique(f_in, l_in, p);
+    rhs(*lhs.f());
+    if (rhs.f() == rhs.l())
+      return;
 
-  using reverse_it = typename C::reverse_iterator;
-  auto move_reverse_it =
-      [](Iterator<C> it) { return std::make_move_iterator(reverse_it(it)); };
+    if (p(*lhs.f(), *rhs.f()))
+      continue;
 
-  auto reverse_remainig_buf_range = detail::set_union_into_tail(
-      reverse_it(buf), reverse_it(orig_l), reverse_it(orig_f),
-      move_reverse_it(l_in), move_reverse_it(f_in), inverse_fn(p));
+    I1 found = lhs.f();
+    lhs.advance();
+    emit(found, lhs.f());
+    rhs.advance();
+    if (lhs.f() == lhs.l() || rhs.f() == rhs.l())
+      return;
+  }
+}
 
-  auto remaining_buf =
-      std::make_pair(reverse_remainig_buf_range.second.base() - c.begin(),
-                     reverse_remainig_buf_range.first.base() - c.begin());
+template <typename I1, typename I2, typename P, typename Emit>
+// requires ForwardIterator<I1> && ForwardIterator<I2> &&
+//          StrictWeakOrdering<P, ValueType<I>> && Emit(I1, I1)
+void set_difference_unbalanced_impl(I1 f1, I1 l1, I2 f2, I2 l2, P p,
+                                    Emit emit) {
+  if (f1 == l1 || f2 == l2) {
+    emit(f1, l1);
+    return;
+  }
 
-  c.erase(c.end() - new_len, c.end());
-  c.erase(c.begin() + remaining_buf.first, c.begin() + remaining_buf.second);
+  lower_bounds_t<I1, P> lhs(f1, l1, p);
+  lower_bounds_t<I2, P> rhs(f2, l2, p);
+  while (true) {
+    I1 run = lhs.f();
+    lhs(*rhs.f());
+    emit(run, lhs.f());
+    if (lhs.f() == lhs.l())
+      return;
+
+    rhs(*lhs.f());
+    if (rhs.f() == rhs.l())
+      break;
+
+    if (!p(*lhs.f(), *rhs.f())) {
+      lhs.advance();
+      rhs.advance();
+      if (lhs.f() == lhs.l() || rhs.f() == rhs.l())
+        break;
+    }
+  }
+  emit(lhs.f(), lhs.l());
 }
 
 }  // namespace detail
 
+// Equal elements are copied from [f1, l1).
+template <typename I1, typename I2, typename O, typename P>
+// requires ForwardIterator<I1> && ForwardIterator<I2> && OutputIterator<O> &&
+//          StrictWeakOrdering<P, ValueType<I>>
+O set_intersection_unbalanced(I1 f1, I1 l1, I2 f2, I2 l2, O o, P p) {
+  detail::set_intersection_unbalanced_impl(
+      f1, l1, f2, l2, p, [&](I1 f, I1 l) { o = detail::copy(f, l, o); });
+  return o;
+}
 
-template <typename Key,
-          typename Comparator = less,
-          typename UnderlyingType = std::vector<Key>>
-// requires (todo)
-class flat_set {
- public:
-  using underlying_type = UnderlyingType;
-  using key_type = Key;
-  using value_type = key_type;
-  using size_type = typename underlying_type::size_type;
-  using difference_type = typename underlying_type::difference_type;
-  using key_compare = Comparator;
-  using value_compare = Comparator;
-  using reference = typename underlying_type::reference;
-  using const_reference = typename underlying_type::const_reference;
-  using pointer = typename underlying_type::pointer;
-  using const_pointer = typename underlying_type::const_pointer;
-  using iterator = typename underlying_type::iterator;
-  using const_iterator = typename underlying_type::const_iterator;
-  using reverse_iterator = typename underlying_type::reverse_iterator;
-  using const_reverse_iterator =
-      typename underlying_type::const_reverse_iterator;
+template <typename I1, typename I2, typename O>
+// requires ForwardIterator<I1> && ForwardIterator<I2> && OutputIterator<O> &&
+//          TotallyOrdered<ValueType<I>>
+O set_intersection_unbalanced(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+  return set_intersection_unbalanced(f1, l1, f2, l2, o, less{});
+}
 
- private:
-  // We cannot use std::tuple for compressed pair, because there is no way to
-  // forward many arguments to one of the members.
-  struct impl_t : value_compare {
-    impl_t() = default;
+template <typename I1, typename I2, typename O, typename P>
+// requires ForwardIterator<I1> && ForwardIterator<I2> && OutputIterator<O> &&
+//          StrictWeakOrdering<P, ValueType<I>>
+O set_difference_unbalanced(I1 f1, I1 l1, I2 f2, I2 l2, O o, P p) {
+  detail::set_difference_unbalanced_impl(
+      f1, l1, f2, l2, p, [&](I1 f, I1 l) { o = detail::copy(f, l, o); });
+  return o;
+}
 
-    template <typename... Args>
-    impl_t(value_compare comp, Args... args)
-        : value_compare(comp), body_{std::forward<Args>(args)...} {};
+template <typename I1, typename I2, typename O>
+// requires ForwardIterator<I1> && ForwardIterator<I2> && OutputIterator<O> &&
+//          TotallyOrdered<ValueType<I>>
+O set_difference_unbalanced(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+  return set_difference_unbalanced(f1, l1, f2, l2, o, less{});
+}
 
-    underlying_type body_;
+// Same loop as set_union_intersecting_parts, except that equal elements are
+// skipped.
+template <typename I1, typename I2, typename O, typename P>
+// requires ForwardIterator<I1> && ForwardIterator<I2> && OutputIterator<O> &&
+//          StrictWeakOrdering<P, ValueType<I>>
+O set_symmetric_difference_unbalanced(I1 f1, I1 l1, I2 f2, I2 l2, O o, P p) {
+  if (f1 == l1 || f2 == l2) {
+    o = detail::copy(f1, l1, o);
+    return detail::copy(f2, l2, o);
   }
-  impl_;
 
-  template <typename V>
-  using type_for_value_compare =
-      typename std::conditional<TransparentComparator<value_compare>(),
-                                V,
-                                value_type>::type;
+  lower_bounds_t<I1, P> lhs(f1, l1, p);
+  lower_bounds_t<I2, P> rhs(f2, l2, p);
+  while (true) {
+    o = detail::advance_set_union(lhs, *rhs.f(), o);
+    if (lhs.f() == lhs.l())
+      break;
 
-  iterator const_cast_iterator(const_iterator c_it) {
-    return begin() + std::distance(cbegin(), c_it);
+    o = detail::advance_set_union(rhs, *lhs.f(), o);
+    if (rhs.f() == rhs.l())
+      break;
+
+    if (!p(*lhs.f(), *rhs.f())) {
+      lhs.advance();
+      rhs.advance();
+      if (lhs.f() == lhs.l() || rhs.f() == rhs.l())
+        break;
+    }
   }
 
- public:
-  // --------------------------------------------------------------------------
-  // Lifetime -----------------------------------------------------------------
+  o = detail::copy(lhs.f(), lhs.l(), o);
+  return detail::copy(rhs.f(), rhs.l(), o);
+}
 
-  flat_set() = default;
-  explicit flat_set(const key_compare& comp) : impl_{comp} {}
+template <typename I1, typename I2, typename O>
+// requires ForwardIterator<I1> && ForwardIterator<I2> && OutputIterator<O> &&
+//          TotallyOrdered<ValueType<I>>
+O set_symmetric_difference_unbalanced(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+  return set_symmetric_difference_unbalanced(f1, l1, f2, l2, o, less{});
+}
 
-  template <typename I>
-  // requires InputIterator<I>
-  flat_set(I f, I l, const key_compare& comp = key_compare())
-      : impl_(comp, f, l) {
-    erase(sort_and_unique(begin(), end(), key_compare()), end());
-  }
+// set_union_n ----------------------------------------------------------------
 
-  flat_set(const flat_set&) = default;
-  flat_set(flat_set&&) = default;
+namespace detail {
 
-  explicit flat_set(underlying_type buf,
-                    const key_compare& comp = key_compare())
-      : impl_{comp, std::move(buf)} {
-    erase(sort_and_unique(begin(), end(), key_compare()), end());
-  }
+// Tournament tree over k sorted ranges. Every inner node keeps the range
+// that lost the match there, so after the winner advances, only the matches
+// on its path to the root are replayed: log(k) comparisons per element.
+// Matches look at cached pointers to the first elements, an exhausted range
+// has nullptr and loses to everything.
+template <typename I, typename P>
+// requires ForwardIterator<I> && StrictWeakOrdering<P, ValueType<I>>
+class loser_tree {
+  using head_t = const ValueType<I>*;
 
-  flat_set(std::initializer_list<value_type> il,
-           const key_compare& comp = key_compare())
-      : flat_set(il.begin(), il.end(), comp) {}
+ public:
+  template <typename RI>
+  loser_tree(RI f, RI l, P p) : p_(p) {
+    for (; f != l; ++f)
+      ranges_.emplace_back(std::begin(*f), std::end(*f));
+
+    // At least two leaves, so that the winner always has a runner up.
+    leaves_ = 2;
+    while (leaves_ < ranges_.size())
+      leaves_ *= 2;
+    ranges_.resize(leaves_, {I{}, I{}});
+
+    heads_.resize(leaves_);
+    for (size_t i = 0; i < leaves_; ++i)
+      update_head(i);
+
+    losers_.resize(leaves_);
+    std::vector<size_t> winners(2 * leaves_);
+    for (size_t i = 0; i < leaves_; ++i)
+      winners[leaves_ + i] = i;
+    for (size_t node = leaves_ - 1; node; --node) {
+      size_t lhs = winners[2 * node];
+      size_t rhs = winners[2 * node + 1];
+      bool lhs_wins = beats(lhs, rhs);
+      winners[node] = lhs_wins ? lhs : rhs;
+      losers_[node] = lhs_wins ? rhs : lhs;
+    }
+    winner_ = winners[1];
+  }
 
-  ~flat_set() = default;
+  bool done() const { return !heads_[winner_]; }
 
-  // --------------------------------------------------------------------------
-  // Assignments --------------------------------------------------------------
+  size_t winner() const { return winner_; }
+  std::pair<I, I>& range(size_t i) { return ranges_[i]; }
+  head_t head(size_t i) const { return heads_[i]; }
 
-  flat_set& operator=(const flat_set&) = default;
-  flat_set& operator=(flat_set&&) = default;
-  flat_set& operator=(std::initializer_list<value_type> il) {
-    body() = il;
-    erase(sort_and_unique(begin(), end(), key_compare()), end());
-    return *this;
+  // Smallest of the other ranges: it lost to the winner on its path.
+  size_t runner_up() const {
+    size_t res = losers_[(winner_ + leaves_) / 2];
+    for (size_t node = (winner_ + leaves_) / 4; node; node /= 2) {
+      if (beats(losers_[node], res))
+        res = losers_[node];
+    }
+    return res;
   }
 
-  //---------------------------------------------------------------------------
-  // Memory management.
+  // Call after the winner's range changes.
+  void replay() {
+    size_t candidate = winner_;
+    update_head(candidate);
+    for (size_t node = (winner_ + leaves_) / 2; node; node /= 2) {
+      // Selects instead of a branch: the outcome is not predictable.
+      size_t loser = losers_[node];
+      bool loser_wins = beats(loser, candidate);
+      losers_[node] = loser_wins ? candidate : loser;
+      candidate = loser_wins ? loser : candidate;
+    }
+    winner_ = candidate;
+  }
+
+ private:
+  void update_head(size_t i) {
+    const auto& r = ranges_[i];
+    heads_[i] = r.first == r.second ? nullptr : &*r.first;
+  }
+
+  // Ties go to the smaller index.
+  bool beats(size_t x, size_t y) const {
+    head_t x_v = heads_[x];
+    head_t y_v = heads_[y];
+    if (!x_v || !y_v)
+      return x_v;
+    // Both comparisons are done to avoid an unpredictable branch.
+    bool x_less = p_(*x_v, *y_v);
+    bool y_less = p_(*y_v, *x_v);
+    return x_less | ((x < y) & !y_less);
+  }
+
+  mutable P p_;
+  std::vector<std::pair<I, I>> ranges_;
+  std::vector<head_t> heads_;
+  std::vector<size_t> losers_;
+  size_t leaves_ = 2;
+  size_t winner_ = 0;
+};
+
+}  // namespace detail
+
+// After this many elements in a row from the same range, set_union_n
+// gallops through it up to the smallest element of the other ranges.
+constexpr size_t kSetUnionNGallopStreak = 8;
+
+// Union of the sorted and unique ranges from [f, l): a k-way merge with a
+// loser tree that drops duplicates on the fly. Equal elements are taken
+// from the first range that has them.
+template <typename RI, typename O, typename P>
+// requires ForwardIterator<RI> && ForwardRange<ValueType<RI>> &&
+//          OutputIterator<O> && StrictWeakOrdering<P, ValueType<...>>
+O set_union_n(RI f, RI l, O o, P p) {
+  using I = decltype(std::begin(*f));
+
+  detail::loser_tree<I, P> tree(f, l, p);
+  I last{};
+  bool has_last = false;
+  size_t streak_range = 0;
+  size_t streak = 0;
+
+  while (!tree.done()) {
+    size_t w = tree.winner();
+    std::pair<I, I>& range = tree.range(w);
+
+    streak = w == streak_range ? streak + 1 : 1;
+    streak_range = w;
+
+    if (has_last && !p(*last, *range.first)) {
+      ++range.first;
+    } else if (streak < kSetUnionNGallopStreak) {
+      last = range.first++;
+      has_last = true;
+      *o = *last;
+      ++o;
+    } else {
+      // Everything in front of the runner up goes in one copy.
+      size_t runner_up = tree.runner_up();
+      I block_l = range.second;
+      if (tree.head(runner_up)) {
+        const auto& bound = *tree.head(runner_up);
+        partition_points_t<I> searcher(range.first, range.second);
+        block_l = searcher([&](Reference<I> x) { return p(x, bound); });
+      }
+      if (block_l == range.first) {
+        // Equal to the runner up.
+        last = range.first++;
+        has_last = true;
+        *o = *last;
+        ++o;
+      } else {
+        o = detail::copy(range.first, block_l, o);
+        last = std::prev(block_l);
+        has_last = true;
+        range.first = block_l;
+      }
+      streak = 0;
+    }
+    tree.replay();
+  }
+  return o;
+}
+
+template <typename RI, typename O>
+// requires ForwardIterator<RI> && ForwardRange<ValueType<RI>> &&
+//          OutputIterator<O> && TotallyOrdered<ValueType<...>>
+O set_union_n(RI f, RI l, O o) {
+  return set_union_n(f, l, o, less{});
+}
+
+// sort_and_unique ------------------------------------------------------------
+
+// Think: stable_sort is a merge sort. Merge can be replaced with set_union ->
+// unique would not be required. Quick sort is not modified that easily (is it?)
+// to do this. How much does the unique matter? For the 1000 elements - log is
+// 10 - unique is 1 => 1/10? Measuring this would be cool.
+//
+// Measured (merge_sort_and_unique, sort_and_unique_bench.cc): for ints
+// std::sort + std::unique is 2.5x faster on 1000 elements and 2x on 1M.
+// Dropping duplicates early only closes the gap a little, even at 90%
+// duplicates: on random data the galloping in set_union never pays off and
+// unique was the cheap part anyway.
+
+namespace detail {
+
+// Merges sorted unique runs pairwise with set_union, which drops the
+// duplicates between them, until one is left. Unique elements of a run are
+// [first, second), the rest of it, up to the start of the next one, is
+// garbage. Returns the end of the unique elements of [f, ...).
+template <typename I, typename Comparator>
+// requires RandomAccessIterator<I>() &&
+//          StrictWeakOrdering<Comparator(ValueType<I>())>
+I merge_unique_runs(I f, std::vector<std::pair<I, I>> runs, Comparator comp) {
+  if (runs.empty())
+    return f;
+
+  std::vector<ValueType<I>> buffer;
+  while (runs.size() > 1) {
+    std::vector<std::pair<I, I>> merged;
+    merged.reserve((runs.size() + 1) / 2);
+
+    for (size_t i = 0; i + 1 < runs.size(); i += 2) {
+      const auto& lhs = runs[i];
+      const auto& rhs = runs[i + 1];
+      buffer.clear();
+      set_union_unbalanced(std::make_move_iterator(lhs.first),
+                           std::make_move_iterator(lhs.second),
+                           std::make_move_iterator(rhs.first),
+                           std::make_move_iterator(rhs.second),
+                           std::back_inserter(buffer), comp);
+      merged.emplace_back(
+          lhs.first, std::move(buffer.begin(), buffer.end(), lhs.first));
+    }
+    if (runs.size() % 2)
+      merged.push_back(runs.back());
+    runs.swap(merged);
+  }
+
+  return runs.front().second;
+}
+
+// Sorted runs of at least this length are kept, shorter ones are sorted
+// together.
+constexpr std::ptrdiff_t kMinSortedRun = 64;
+
+// Finds ascending runs in one pass, the stretches between long runs are
+// sorted. Then the runs are merged, so sorted unique input costs one
+// comparison per element and a sorted input with an unsorted tail costs
+// sorting the tail.
+template <typename I, typename Comparator>
+// requires RandomAccessIterator<I>() &&
+//          StrictWeakOrdering<Comparator(ValueType<I>())>
+I sort_and_unique_adaptive(I f, I l, Comparator comp) {
+  std::vector<std::pair<I, I>> runs;
+
+  I unsorted_f = f;
+  auto sort_unsorted = [&](I unsorted_l) {
+    if (unsorted_f == unsorted_l)
+      return;
+    runs.emplace_back(
+        unsorted_f, sort_and_unique_dispatch(unsorted_f, unsorted_l, comp,
+                                             use_radix_sort<I, Comparator>{}));
+  };
+
+  for (I run_f = f; run_f != l;) {
+    I run_l = std::is_sorted_until(run_f, l, comp);
+    if (run_l - run_f >= kMinSortedRun) {
+      sort_unsorted(run_f);
+      runs.emplace_back(run_f, std::unique(run_f, run_l, not_fn(comp)));
+      unsorted_f = run_l;
+    }
+    run_f = run_l;
+  }
+  sort_unsorted(l);
+
+  return merge_unique_runs(f, std::move(runs), comp);
+}
+
+}  // namespace detail
+
+template <typename I, typename Comparator>
+// requires RandomAccessIterator<I>() && // It's possible to use Forward
+//                                       // but I would have to redo std::sort.
+//          StrictWeakOrdering<Comparator(ValueType<I>())>
+I sort_and_unique(I f, I l, Comparator comp) {
+  return detail::sort_and_unique_adaptive(f, l, comp);
+}
+
+template <typename I>
+I sort_and_unique(I f, I l) {
+  return sort_and_unique(f, l, less{});
+}
+
+// Bottom up merge sort, where merge is set_union: duplicates are dropped on
+// every level, so with a lot of them the later levels get shorter.
+// Blocks of kMergeSortBlock elements are sorted with std::sort first.
+constexpr std::ptrdiff_t kMergeSortBlock = 32;
+
+template <typename I, typename Comparator>
+// requires RandomAccessIterator<I>() &&
+//          StrictWeakOrdering<Comparator(ValueType<I>())>
+I merge_sort_and_unique(I f, I l, Comparator comp) {
+  std::vector<std::pair<I, I>> runs;
+  runs.reserve(static_cast<size_t>((l - f) / kMergeSortBlock + 1));
+  for (I block_f = f; block_f != l;) {
+    I block_l = l - block_f > kMergeSortBlock ? block_f + kMergeSortBlock : l;
+    std::sort(block_f, block_l, comp);
+    runs.emplace_back(block_f, std::unique(block_f, block_l, not_fn(comp)));
+    block_f = block_l;
+  }
+  return detail::merge_unique_runs(f, std::move(runs), comp);
+}
+
+template <typename I>
+I merge_sort_and_unique(I f, I l) {
+  return merge_sort_and_unique(f, l, less{});
+}
+
+
+// parallel set_union ---------------------------------------------------------
+
+namespace detail {
+
+// Runs f(0) ... f(n - 1), each on its own thread. f(0) runs on the calling
+// thread. Exceptions are rethrown after all of the tasks are done.
+template <typename F>
+void parallel_for(size_t n, F f) {
+  std::vector<std::future<void>> tasks;
+  tasks.reserve(n);
+  for (size_t i = 1; i < n; ++i)
+    tasks.push_back(std::async(std::launch::async, f, i));
+  f(size_t{0});
+  for (auto& task : tasks)
+    task.get();
+}
+
+constexpr size_t kCacheLineSize = 64;
+
+// Keeps value on cache lines of its own, so that threads writing to
+// different objects do not invalidate each other's lines. alignas(64) is
+// not enough before C++17: new only guarantees 16 bytes and the object can
+// start in the middle of a line. Padding on both sides works for any
+// alignment.
+template <typename T>
+struct cache_line_padded {
+  template <typename... Args>
+  explicit cache_line_padded(Args&&... args)
+      : value(std::forward<Args>(args)...) {}
+
+  char padding_before[kCacheLineSize];
+  T value;
+  char padding_after[kCacheLineSize];
+};
+
+inline size_t default_thread_count() {
+  static const size_t res = std::max(std::thread::hardware_concurrency(), 1u);
+  return res;
+}
+
+// Merge path: among the first d elements of merge(f1, f2) (ties go to f1),
+// how many come from f1.
+template <typename I1, typename I2, typename P>
+// requires RandomAccessIterator<I1> && RandomAccessIterator<I2> &&
+//          StrictWeakOrdering<P, ValueType<I>>
+std::ptrdiff_t merge_path_split(I1 f1, std::ptrdiff_t n1,
+                                I2 f2, std::ptrdiff_t n2,
+                                std::ptrdiff_t d, P p) {
+  std::ptrdiff_t lo = std::max(std::ptrdiff_t{0}, d - n2);
+  std::ptrdiff_t hi = std::min(d, n1);
+  while (lo < hi) {
+    std::ptrdiff_t mid = lo + (hi - lo) / 2;
+    if (!p(f2[d - mid - 1], f1[mid]))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+}  // namespace detail
+
+namespace detail {
+
+// set_union_parallel without the size check.
+// The inputs are not read after the chunks are merged into the buffer, so o
+// is allowed to point into them.
+template <typename I1, typename I2, typename O, typename P>
+// requires RandomAccessIterator<I1> && RandomAccessIterator<I2> &&
+//          RandomAccessIterator<O> &&
+//          StrictWeakOrdering<P, ValueType<I>>
+O set_union_parallel_impl(I1 f1, I1 l1, I2 f2, I2 l2, O o, P p,
+                          size_t num_threads) {
+  using value_type = typename std::iterator_traits<I1>::value_type;
+
+  const std::ptrdiff_t n1 = l1 - f1;
+  const std::ptrdiff_t n2 = l2 - f2;
+  const std::ptrdiff_t total = n1 + n2;
+  num_threads = std::max(
+      std::min(num_threads, static_cast<size_t>(total)), size_t{1});
+
+  std::vector<std::pair<std::ptrdiff_t, std::ptrdiff_t>> cuts(num_threads + 1);
+  cuts.front() = {0, 0};
+  cuts.back() = {n1, n2};
+  for (size_t k = 1; k < num_threads; ++k) {
+    std::ptrdiff_t d = static_cast<std::ptrdiff_t>(
+        static_cast<size_t>(total) * k / num_threads);
+    std::ptrdiff_t i = merge_path_split(f1, n1, f2, n2, d, p);
+    std::ptrdiff_t j = d - i;
+
+    if (i == n1 && j == n2) {
+      cuts[k] = cuts.back();
+      continue;
+    }
+    const bool from_first = j == n2 || (i != n1 && !p(f2[j], f1[i]));
+    const value_type& pivot = from_first ? f1[i] : f2[j];
+    cuts[k] = {std::lower_bound(f1, l1, pivot, p) - f1,
+               std::lower_bound(f2, l2, pivot, p) - f2};
+  }
+
+  std::vector<value_type> buffer(static_cast<size_t>(total));
+  std::vector<std::ptrdiff_t> sizes(num_threads);
+  parallel_for(num_threads, [&](size_t k) {
+    auto b = cuts[k];
+    auto e = cuts[k + 1];
+    auto out = buffer.begin() + b.first + b.second;
+    sizes[k] = set_union_unbalanced(f1 + b.first, f1 + e.first,
+                                    f2 + b.second, f2 + e.second, out, p) -
+               out;
+  });
+
+  std::vector<std::ptrdiff_t> offsets(num_threads + 1, 0);
+  std::partial_sum(sizes.begin(), sizes.end(), offsets.begin() + 1);
+
+  parallel_for(num_threads, [&](size_t k) {
+    auto from = buffer.begin() + cuts[k].first + cuts[k].second;
+    std::move(from, from + sizes[k], o + offsets[k]);
+  });
+
+  return o + offsets.back();
+}
+
+}  // namespace detail
+
+// Below this many elements threads cost more than they save.
+constexpr size_t kParallelSetUnionThreshold = 1 << 16;
+
+// set_union_unbalanced, split between num_threads threads.
+// Both inputs are cut into chunks along the merge path diagonals, so every
+// chunk gets the same amount of work no matter how the elements are
+// distributed. Each cut is then moved to the lower_bound of the element on
+// it, so that equal elements from both inputs end up in the same chunk.
+// Chunks are merged into a buffer and then copied to o in parallel.
+template <typename I1, typename I2, typename O, typename P>
+// requires RandomAccessIterator<I1> && RandomAccessIterator<I2> &&
+//          RandomAccessIterator<O> &&
+//          StrictWeakOrdering<P, ValueType<I>>
+O set_union_parallel(I1 f1, I1 l1, I2 f2, I2 l2, O o, P p,
+                     size_t num_threads) {
+  if (num_threads <= 1 ||
+      static_cast<size_t>((l1 - f1) + (l2 - f2)) < kParallelSetUnionThreshold)
+    return set_union_unbalanced(f1, l1, f2, l2, o, p);
+  return detail::set_union_parallel_impl(f1, l1, f2, l2, o, p, num_threads);
+}
+
+template <typename I1, typename I2, typename O, typename P>
+// requires RandomAccessIterator<I1> && RandomAccessIterator<I2> &&
+//          RandomAccessIterator<O> &&
+//          StrictWeakOrdering<P, ValueType<I>>
+O set_union_parallel(I1 f1, I1 l1, I2 f2, I2 l2, O o, P p) {
+  return set_union_parallel(f1, l1, f2, l2, o, p,
+                            detail::default_thread_count());
+}
+
+template <typename I1, typename I2, typename O>
+// requires RandomAccessIterator<I1> && RandomAccessIterator<I2> &&
+//          RandomAccessIterator<O> &&
+//          TotallyOrdered<ValueType<I>>
+O set_union_parallel(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+  return set_union_parallel(f1, l1, f2, l2, o, less{});
+}
+
+// parallel sort_and_unique ---------------------------------------------------
+
+namespace detail {
+
+template <typename I>
+using can_sort_and_unique_in_parallel = std::integral_constant<
+    bool,
+    std::is_base_of<std::random_access_iterator_tag,
+                    typename std::iterator_traits<I>::iterator_category>::
+            value &&
+        std::is_default_constructible<
+            typename std::iterator_traits<I>::value_type>::value>;
+
+template <typename I, typename Comparator>
+I sort_and_unique_parallel(I f, I l, Comparator comp, size_t, std::false_type) {
+  return sort_and_unique(f, l, comp);
+}
+
+// Every thread sorts and uniques its own chunk, then neighbouring runs are
+// merged pairwise with set_union, which also drops the duplicates between
+// them. As the number of runs halves, each merge gets more threads, so all
+// of them are busy until the very last merge.
+template <typename I, typename Comparator>
+I sort_and_unique_parallel(I f,
+                           I l,
+                           Comparator comp,
+                           size_t num_threads,
+                           std::true_type) {
+  const size_t size = static_cast<size_t>(l - f);
+
+  // Unique elements of a run are [first, second). The rest of the run, up to
+  // the start of the next one, is garbage.
+  std::vector<std::pair<I, I>> runs(num_threads);
+  parallel_for(num_threads, [&](size_t k) {
+    I run_f = f + static_cast<std::ptrdiff_t>(size * k / num_threads);
+    I run_l = f + static_cast<std::ptrdiff_t>(size * (k + 1) / num_threads);
+    runs[k] = {run_f, sort_and_unique(run_f, run_l, comp)};
+  });
+
+  while (runs.size() > 1) {
+    const size_t pairs = runs.size() / 2;
+    const size_t threads_per_merge = std::max(num_threads / pairs, size_t{1});
+
+    std::vector<std::pair<I, I>> merged((runs.size() + 1) / 2);
+    if (runs.size() % 2)
+      merged.back() = runs.back();
+
+    parallel_for(pairs, [&](size_t k) {
+      const auto& lhs = runs[2 * k];
+      const auto& rhs = runs[2 * k + 1];
+      merged[k] = {lhs.first,
+                   set_union_parallel_impl(
+                       std::make_move_iterator(lhs.first),
+                       std::make_move_iterator(lhs.second),
+                       std::make_move_iterator(rhs.first),
+                       std::make_move_iterator(rhs.second), lhs.first, comp,
+                       threads_per_merge)};
+    });
+    runs.swap(merged);
+  }
+
+  return runs.front().second;
+}
+
+}  // namespace detail
+
+// Below this many elements sort_and_unique_parallel is just sort_and_unique.
+constexpr size_t kParallelSortThreshold = 1 << 17;
+
+// sort_and_unique that uses up to num_threads threads.
+// Iterators that are not random access and types that are not default
+// constructible (we need a buffer for merging) are done on one thread.
+template <typename I, typename Comparator>
+// requires ForwardIterator<I>() &&
+//          StrictWeakOrdering<Comparator(ValueType<I>())>
+I sort_and_unique_parallel(I f, I l, Comparator comp, size_t num_threads) {
+  const auto size = static_cast<size_t>(std::distance(f, l));
+  num_threads = std::min(num_threads, size / kParallelSortThreshold + 1);
+  if (num_threads <= 1)
+    return sort_and_unique(f, l, comp);
+  return detail::sort_and_unique_parallel(
+      f, l, comp, num_threads, detail::can_sort_and_unique_in_parallel<I>{});
+}
+
+template <typename I, typename Comparator>
+// requires ForwardIterator<I>() &&
+//          StrictWeakOrdering<Comparator(ValueType<I>())>
+I sort_and_unique_parallel(I f, I l, Comparator comp) {
+  if (static_cast<size_t>(std::distance(f, l)) < kParallelSortThreshold)
+    return sort_and_unique(f, l, comp);
+  return sort_and_unique_parallel(f, l, comp, detail::default_thread_count());
+}
+
+template <typename I>
+I sort_and_unique_parallel(I f, I l) {
+  return sort_and_unique_parallel(f, l, less{});
+}
+
+// simd lower_bound ------------------------------------------------------------
+//
+// For arithmetic keys compared with operator< we do a few branchless binary
+// steps until the range fits in one cache line and then compare the whole
+// line at once. Elements before the range are all less than the value, after
+// it - not less, so the window can be shifted left to stay in bounds.
+
+namespace detail {
+
+template <typename T>
+struct simd_block : std::integral_constant<std::ptrdiff_t, 64 / sizeof(T)> {};
+
+template <typename T>
+// requires TotallyOrdered<T>
+size_t count_less_block(const T* f, T v) {
+  size_t res = 0;
+  for (std::ptrdiff_t i = 0; i != simd_block<T>::value; ++i)
+    res += f[i] < v;
+  return res;
+}
+
+// Comparisons produce -1 for every element that is less, so we sum them up
+// instead of movemask + popcount: without -mpopcnt the latter is a call.
+
+#if defined(__SSE2__)
+
+inline size_t negated_sum_epi32(__m128i x) {
+  x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+  x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+  return static_cast<size_t>(-_mm_cvtsi128_si32(x));
+}
+
+inline size_t negated_sum_epi64(__m128i x) {
+  x = _mm_add_epi64(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+  return static_cast<size_t>(-_mm_cvtsi128_si64(x));
+}
+
+#endif  // defined(__SSE2__)
+
+#if defined(__AVX2__)
+
+inline size_t negated_sum_epi32(__m256i x) {
+  return negated_sum_epi32(_mm_add_epi32(_mm256_castsi256_si128(x),
+                                         _mm256_extracti128_si256(x, 1)));
+}
+
+inline size_t negated_sum_epi64(__m256i x) {
+  return negated_sum_epi64(_mm_add_epi64(_mm256_castsi256_si128(x),
+                                         _mm256_extracti128_si256(x, 1)));
+}
+
+inline size_t count_less_block(const std::int32_t* f, std::int32_t v) {
+  const __m256i vv = _mm256_set1_epi32(v);
+  const __m256i* in = reinterpret_cast<const __m256i*>(f);
+  return negated_sum_epi32(
+      _mm256_add_epi32(_mm256_cmpgt_epi32(vv, _mm256_loadu_si256(in)),
+                       _mm256_cmpgt_epi32(vv, _mm256_loadu_si256(in + 1))));
+}
+
+inline size_t count_less_block(const std::uint32_t* f, std::uint32_t v) {
+  // There is no unsigned comparison, flipping the sign bit fixes the order.
+  const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+  const __m256i vv =
+      _mm256_xor_si256(_mm256_set1_epi32(static_cast<std::int32_t>(v)), sign);
+  const __m256i* in = reinterpret_cast<const __m256i*>(f);
+  __m256i x = _mm256_xor_si256(_mm256_loadu_si256(in), sign);
+  __m256i y = _mm256_xor_si256(_mm256_loadu_si256(in + 1), sign);
+  return negated_sum_epi32(
+      _mm256_add_epi32(_mm256_cmpgt_epi32(vv, x), _mm256_cmpgt_epi32(vv, y)));
+}
+
+inline size_t count_less_block(const std::int64_t* f, std::int64_t v) {
+  const __m256i vv = _mm256_set1_epi64x(v);
+  const __m256i* in = reinterpret_cast<const __m256i*>(f);
+  return negated_sum_epi64(
+      _mm256_add_epi64(_mm256_cmpgt_epi64(vv, _mm256_loadu_si256(in)),
+                       _mm256_cmpgt_epi64(vv, _mm256_loadu_si256(in + 1))));
+}
+
+#elif defined(__SSE2__)
+
+inline size_t count_less_block(const std::int32_t* f, std::int32_t v) {
+  const __m128i vv = _mm_set1_epi32(v);
+  const __m128i* in = reinterpret_cast<const __m128i*>(f);
+  __m128i res = _mm_setzero_si128();
+  for (int i = 0; i != 4; ++i)
+    res = _mm_add_epi32(res, _mm_cmpgt_epi32(vv, _mm_loadu_si128(in + i)));
+  return negated_sum_epi32(res);
+}
+
+inline size_t count_less_block(const std::uint32_t* f, std::uint32_t v) {
+  // There is no unsigned comparison, flipping the sign bit fixes the order.
+  const __m128i sign = _mm_set1_epi32(INT32_MIN);
+  const __m128i vv =
+      _mm_xor_si128(_mm_set1_epi32(static_cast<std::int32_t>(v)), sign);
+  const __m128i* in = reinterpret_cast<const __m128i*>(f);
+  __m128i res = _mm_setzero_si128();
+  for (int i = 0; i != 4; ++i) {
+    __m128i x = _mm_xor_si128(_mm_loadu_si128(in + i), sign);
+    res = _mm_add_epi32(res, _mm_cmpgt_epi32(vv, x));
+  }
+  return negated_sum_epi32(res);
+}
+
+#if defined(__SSE4_2__)
+
+inline size_t count_less_block(const std::int64_t* f, std::int64_t v) {
+  const __m128i vv = _mm_set1_epi64x(v);
+  const __m128i* in = reinterpret_cast<const __m128i*>(f);
+  __m128i res = _mm_setzero_si128();
+  for (int i = 0; i != 4; ++i)
+    res = _mm_add_epi64(res, _mm_cmpgt_epi64(vv, _mm_loadu_si128(in + i)));
+  return negated_sum_epi64(res);
+}
+
+#endif  // defined(__SSE4_2__)
+#endif  // defined(__AVX2__)
+
+template <typename T>
+// requires Arithmetic<T>
+const T* lower_bound_simd(const T* f, const T* l, T v) {
+  constexpr std::ptrdiff_t kBlock = simd_block<T>::value;
+  std::ptrdiff_t len = l - f;
+
+  if (len < kBlock) {
+    std::ptrdiff_t res = 0;
+    for (std::ptrdiff_t i = 0; i != len; ++i)
+      res += f[i] < v;
+    return f + res;
+  }
+
+  // Prefetching both possible next probes hides the latency on big sets,
+  // which branchy search gets from speculation.
+  while (len > kBlock) {
+    std::ptrdiff_t half = len / 2;
+    std::ptrdiff_t next_half = (len - half) / 2;
+    __builtin_prefetch(f + next_half);
+    __builtin_prefetch(f + half + next_half);
+    f = (f[half] < v) ? f + half : f;
+    len -= half;
+  }
+
+  const T* window = std::min(f, l - kBlock);
+  return window + count_less_block(window, v);
+}
+
+// The value has to be of the same type: converting 2.5 to int would change
+// the answer.
+template <typename I, typename V, typename P>
+using use_simd_lower_bound = std::integral_constant<
+    bool,
+    std::is_arithmetic<ValueType<I>>::value &&
+        std::is_same<ValueType<I>, V>::value &&
+        is_less_than_operator<P>::value && is_contiguous_iterator<I>::value>;
+
+template <typename I, typename V, typename P>
+I lower_bound_dispatch(I f, I l, const V& v, P p, std::false_type) {
+  return std::lower_bound(f, l, v, p);
+}
+
+template <typename I, typename V, typename P>
+I lower_bound_dispatch(I f, I l, const V& v, P, std::true_type) {
+  if (f == l)
+    return f;
+  const V* data = &*f;
+  return f + (lower_bound_simd(data, data + (l - f), v) - data);
+}
+
+}  // namespace detail
+
+template <typename I, typename V, typename P>
+// requires ForwardIterator<I> && StrictWeakOrdering<P, ValueType<I>>
+I lower_bound(I f, I l, const V& v, P p) {
+  return detail::lower_bound_dispatch(
+      f, l, v, p, detail::use_simd_lower_bound<I, V, P>{});
+}
+
+// batched lookups ------------------------------------------------------------
+
+// Branchless binary search for a group of queries at once. The length of the
+// range only depends on the size, so all of the searches in a group make the
+// same number of steps and can advance in lockstep. After every step we
+// prefetch the next probe of each search: the cache misses of the different
+// queries overlap.
+template <typename I, typename QI, typename O, typename P>
+// requires RandomAccessIterator<I> && ForwardIterator<QI> &&
+//          OutputIterator<O, I> && StrictWeakOrdering<P, ValueType<I>>
+O lower_bound_batch(I f, I l, QI qf, QI ql, O o, P p) {
+  constexpr size_t kGroupSize = 16;
+
+  const auto len = std::distance(f, l);
+  I bases[kGroupSize];
+  QI queries[kGroupSize];
+
+  while (qf != ql) {
+    size_t group_size = 0;
+    for (; group_size != kGroupSize && qf != ql; ++group_size, ++qf) {
+      bases[group_size] = f;
+      queries[group_size] = qf;
+    }
+
+    if (len) {
+      for (auto step_len = len; step_len > 1;) {
+        auto half = step_len / 2;
+        auto next_half = (step_len - half) / 2;
+        for (size_t i = 0; i != group_size; ++i) {
+          I probe = bases[i] + half;
+          bases[i] = p(*probe, *queries[i]) ? probe : bases[i];
+          __builtin_prefetch(std::addressof(bases[i][next_half]));
+        }
+        step_len -= half;
+      }
+
+      for (size_t i = 0; i != group_size; ++i)
+        bases[i] += static_cast<DifferenceType<I>>(p(*bases[i], *queries[i]));
+    }
+
+    o = std::copy(bases, bases + group_size, o);
+  }
+
+  return o;
+}
+
+namespace detail {
+
+template <typename I, typename QI, typename O, typename P>
+struct find_output_iterator {
+  using iterator_category = std::output_iterator_tag;
+  using value_type = void;
+  using difference_type = void;
+  using pointer = void;
+  using reference = void;
+
+  find_output_iterator& operator*() { return *this; }
+  find_output_iterator& operator++() { return *this; }
+  find_output_iterator& operator++(int) { return *this; }
+
+  find_output_iterator& operator=(I pos) {
+    *o++ = (pos == l || p(*q, *pos)) ? l : pos;
+    ++q;
+    return *this;
+  }
+
+  I l;
+  QI q;
+  O o;
+  P p;
+};
+
+}  // namespace detail
+
+template <typename I, typename QI, typename O, typename P>
+// requires RandomAccessIterator<I> && ForwardIterator<QI> &&
+//          OutputIterator<O, I> && StrictWeakOrdering<P, ValueType<I>>
+O find_batch(I f, I l, QI qf, QI ql, O o, P p) {
+  using find_output = detail::find_output_iterator<I, QI, O, P>;
+  return lower_bound_batch(f, l, qf, ql, find_output{l, qf, o, p}, p).o;
+}
+
+// search policies ------------------------------------------------------------
+
+template <typename I, typename V, typename P>
+// requires ForwardIterator<I> && StrictWeakOrdering<P, ValueType<I>>
+I lower_bound_linear(I f, I l, const V& v, P p) {
+  return std::find_if_not(f, l, [&](Reference<I> x) { return p(x, v); });
+}
+
+template <typename I, typename V>
+// requires ForwardIterator<I> && TotallyOrdered<ValueType<I>>
+I lower_bound_linear(I f, I l, const V& v) {
+  return lower_bound_linear(f, l, v, less{});
+}
+
+template <typename I, typename P>
+// requires ForwardIterator<I> && UnaryPredicate<P, ValueType<I>>
+I partition_point_biased(I f, I l, P p) {
+  if (f == l)
+    return f;
+  return partition_points_t<I>(f, l)(p);
+}
+
+template <typename I, typename V, typename P>
+// requires ForwardIterator<I> && StrictWeakOrdering<P, ValueType<I>>
+I lower_bound_biased(I f, I l, const V& v, P p) {
+  return partition_point_biased(f, l,
+                                [&](Reference<I> x) { return p(x, v); });
+}
+
+template <typename I, typename V>
+// requires ForwardIterator<I> && TotallyOrdered<ValueType<I>>
+I lower_bound_biased(I f, I l, const V& v) {
+  return lower_bound_biased(f, l, v, less{});
+}
+
+// The loop does not depend on the result of the predicate, only the value of
+// f does, so the compiler emits a cmov instead of a branch.
+template <typename I, typename P>
+// requires RandomAccessIterator<I> && UnaryPredicate<P, ValueType<I>>
+I partition_point_branchless(I f, I l, P p) {
+  auto len = std::distance(f, l);
+  if (!len)
+    return f;
+
+  while (len > 1) {
+    auto half = len / 2;
+    f = p(f[half]) ? f + half : f;
+    len -= half;
+  }
+  return f + static_cast<DifferenceType<I>>(p(*f));
+}
+
+template <typename I, typename V, typename P>
+// requires RandomAccessIterator<I> && StrictWeakOrdering<P, ValueType<I>>
+I lower_bound_branchless(I f, I l, const V& v, P p) {
+  return partition_point_branchless(f, l,
+                                    [&](Reference<I> x) { return p(x, v); });
+}
+
+template <typename I, typename V>
+// requires RandomAccessIterator<I> && TotallyOrdered<ValueType<I>>
+I lower_bound_branchless(I f, I l, const V& v) {
+  return lower_bound_branchless(f, l, v, less{});
+}
+
+// Search policies decide how flat_set looks for elements. Default is the
+// binary search (that switches to simd for arithmetic types).
+struct binary_search_policy {
+  template <typename I, typename V, typename P>
+  I lower_bound(I f, I l, const V& v, P p) const {
+    return lib::lower_bound(f, l, v, p);
+  }
+
+  template <typename I, typename V, typename P>
+  I upper_bound(I f, I l, const V& v, P p) const {
+    return std::upper_bound(f, l, v, p);
+  }
+};
+
+namespace detail {
+
+// Policy from a partition point algorithm.
+template <typename PartitionPoint>
+struct partition_point_search_policy {
+  template <typename I, typename V, typename P>
+  I lower_bound(I f, I l, const V& v, P p) const {
+    return PartitionPoint{}(f, l, [&](Reference<I> x) { return p(x, v); });
+  }
+
+  template <typename I, typename V, typename P>
+  I upper_bound(I f, I l, const V& v, P p) const {
+    return PartitionPoint{}(f, l, [&](Reference<I> x) { return !p(v, x); });
+  }
+};
+
+struct linear_partition_point {
+  template <typename I, typename P>
+  I operator()(I f, I l, P p) const {
+    return std::find_if_not(f, l, p);
+  }
+};
+
+struct biased_partition_point {
+  template <typename I, typename P>
+  I operator()(I f, I l, P p) const {
+    return partition_point_biased(f, l, p);
+  }
+};
+
+struct branchless_partition_point {
+  template <typename I, typename P>
+  I operator()(I f, I l, P p) const {
+    return partition_point_branchless(f, l, p);
+  }
+};
+
+}  // namespace detail
+
+// Good for very small sets.
+struct linear_search_policy
+    : detail::partition_point_search_policy<detail::linear_partition_point> {};
+
+// Exponential search from the beginning with a sentinel in the middle:
+// good when looked up elements tend to be small.
+struct biased_search_policy
+    : detail::partition_point_search_policy<detail::biased_partition_point> {};
+
+struct branchless_search_policy
+    : detail::partition_point_search_policy<
+          detail::branchless_partition_point> {};
+
+namespace detail {
+
+// std::move for o at or before f. Does not move the elements onto
+// themselves.
+template <typename I>
+// requires ForwardIterator<I>
+I move_left(I f, I l, I o) {
+  if (f == o)
+    return l;
+  return std::move(f, l, o);
+}
+
+template <typename C, typename I, typename P>
+// requires  Container<C> &&  ForwardIterator<I> &&
+//           StrictWeakOrdering<P(ValueType<C>)>
+void insert_first_last_impl(C& c, I f, I l, P p, size_t num_threads = 1) {
+  auto new_len = std::distance(f, l);
+  auto orig_len = c.size();
+  c.resize(orig_len + 2 * new_len);
+
+  Iterator<C> orig_f = c.begin();
+  Iterator<C> orig_l = c.begin() + orig_len;
+  Iterator<C> f_in = c.end() - new_len;
+  Iterator<C> l_in = c.end();
+  Iterator<C> buf = f_in;
+
+  detail::copy(f, l, f_in);
+  l_in = sort_and_unique_parallel(f_in, l_in, p, num_threads);
+
+  using reverse_it = typename C::reverse_iterator;
+  auto move_reverse_it =
+      [](Iterator<C> it) { return std::make_move_iterator(reverse_it(it)); };
+
+  auto reverse_remainig_buf_range = detail::set_union_into_tail(
+      reverse_it(buf), reverse_it(orig_l), reverse_it(orig_f),
+      move_reverse_it(l_in), move_reverse_it(f_in), inverse_fn(p));
+
+  auto remaining_buf =
+      std::make_pair(reverse_remainig_buf_range.second.base() - c.begin(),
+                     reverse_remainig_buf_range.first.base() - c.begin());
+
+  c.erase(c.end() - new_len, c.end());
+  c.erase(c.begin() + remaining_buf.first, c.begin() + remaining_buf.second);
+}
+
+// Merges adjacent sorted [f, m) and [m, l) without a buffer: splits the
+// longer one in half, finds where the middle goes in the other one and
+// rotates. O((l - f) * log(l - f)) moves. Equal elements from [f, m) go
+// first.
+template <typename I, typename P>
+// requires RandomAccessIterator<I> && StrictWeakOrdering<P(ValueType<I>)>
+void merge_adjacent_in_place(I f, I m, I l, P p) {
+  while (f != m && m != l) {
+    auto len1 = m - f;
+    auto len2 = l - m;
+    if (len1 + len2 == 2) {
+      if (p(*m, *f))
+        std::iter_swap(f, m);
+      return;
+    }
+
+    I cut1, cut2;
+    if (len1 > len2) {
+      cut1 = f + len1 / 2;
+      cut2 = std::lower_bound(m, l, *cut1, p);
+    } else {
+      cut2 = m + len2 / 2;
+      cut1 = std::upper_bound(f, m, *cut2, p);
+    }
+
+    I new_m = std::rotate(cut1, m, cut2);
+    merge_adjacent_in_place(f, cut1, new_m, p);
+    f = new_m;
+    m = cut2;
+  }
+}
+
+// insert_in_place grows the capacity by at least 1/kInPlaceGrowthDivisor
+// of the size: batches at least that big get exactly the space they need,
+// smaller ones still reallocate a logarithmic number of times.
+constexpr size_t kInPlaceGrowthDivisor = 8;
+
+// insert_first_last_impl that only grows the container by the batch size:
+// the batch is sorted in the tail (std::sort, no buffers) and merged with
+// the old elements by rotations. Slower, but the capacity becomes
+// orig_len + max(new_len, orig_len / kInPlaceGrowthDivisor) and the peak
+// memory is that plus the old buffer during reallocation.
+template <typename C, typename I, typename P>
+// requires  Container<C> &&  ForwardIterator<I> &&
+//           StrictWeakOrdering<P(ValueType<C>)>
+void insert_first_last_in_place_impl(C& c, I f, I l, P p) {
+  auto orig_len = c.size();
+  const auto needed = orig_len + static_cast<size_t>(std::distance(f, l));
+  if (needed > c.capacity())
+    c.reserve(std::max(needed, orig_len + orig_len / kInPlaceGrowthDivisor));
+  c.insert(c.end(), f, l);
+
+  Iterator<C> orig_l = c.begin() + orig_len;
+  if (orig_l == c.end())
+    return;
+
+  std::sort(orig_l, c.end(), p);
+  Iterator<C> new_l = std::unique(orig_l, c.end(), not_fn(p));
+
+  // Everything before is less than all of the new elements and stays.
+  auto unchanged = std::lower_bound(c.begin(), orig_l, *orig_l, p) - c.begin();
+
+  merge_adjacent_in_place(c.begin(), orig_l, new_l, p);
+  new_l = std::unique(c.begin() + unchanged, new_l, not_fn(p));
+  c.erase(new_l, c.end());
+}
+
+template <typename I, typename P>
+// requires ForwardIterator<I> && StrictWeakOrdering<P(ValueType<I>)>
+bool is_sorted_unique(I f, I l, P p) {
+  return std::adjacent_find(f, l, not_fn(p)) == l;
+}
+
+// Same as insert_first_last_impl but [f, l) is already sorted and unique,
+// so it is merged straight from the input: no copy, no sort.
+template <typename C, typename I, typename P>
+// requires  Container<C> &&  BidirectionalIterator<I> &&
+//           StrictWeakOrdering<P(ValueType<C>)>
+void insert_sorted_unique_impl(C& c,
+                               I f,
+                               I l,
+                               P p,
+                               std::bidirectional_iterator_tag) {
+  assert(is_sorted_unique(f, l, p));
+
+  auto new_len = std::distance(f, l);
+  auto orig_len = c.size();
+  c.resize(orig_len + new_len);
+
+  Iterator<C> orig_f = c.begin();
+  Iterator<C> orig_l = c.begin() + orig_len;
+
+  using reverse_it = typename C::reverse_iterator;
+  auto reverse_remainig_buf_range = detail::set_union_into_tail(
+      reverse_it(c.end()), reverse_it(orig_l), reverse_it(orig_f),
+      std::reverse_iterator<I>(l), std::reverse_iterator<I>(f),
+      inverse_fn(p));
+
+  c.erase(reverse_remainig_buf_range.second.base(),
+          reverse_remainig_buf_range.first.base());
+}
+
+template <typename C, typename I, typename P>
+// requires  Container<C> &&  InputIterator<I> &&
+//           StrictWeakOrdering<P(ValueType<C>)>
+void insert_sorted_unique_impl(C& c, I f, I l, P p, std::input_iterator_tag) {
+  C buf(f, l);
+  insert_sorted_unique_impl(c, buf.begin(), buf.end(), p,
+                            std::bidirectional_iterator_tag{});
+}
+
+}  // namespace detail
+
+
+template <typename Key,
+          typename Comparator = less,
+          typename UnderlyingType = std::vector<Key>,
+          typename SearchPolicy = binary_search_policy>
+// requires (todo)
+class flat_set {
+ public:
+  using underlying_type = UnderlyingType;
+  using search_policy = SearchPolicy;
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = typename underlying_type::size_type;
+  using difference_type = typename underlying_type::difference_type;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+  using reference = typename underlying_type::reference;
+  using const_reference = typename underlying_type::const_reference;
+  using pointer = typename underlying_type::pointer;
+  using const_pointer = typename underlying_type::const_pointer;
+  using iterator = typename underlying_type::iterator;
+  using const_iterator = typename underlying_type::const_iterator;
+  using reverse_iterator = typename underlying_type::reverse_iterator;
+  using const_reverse_iterator =
+      typename underlying_type::const_reverse_iterator;
+
+ private:
+  // We cannot use std::tuple for compressed pair, because there is no way to
+  // forward many arguments to one of the members.
+  struct impl_t : value_compare {
+    impl_t() = default;
+
+    template <typename... Args>
+    impl_t(value_compare comp, Args... args)
+        : value_compare(comp), body_{std::forward<Args>(args)...} {};
+
+    underlying_type body_;
+  }
+  impl_;
+
+  template <typename V>
+  using type_for_value_compare =
+      typename std::conditional<TransparentComparator<value_compare>(),
+                                V,
+                                value_type>::type;
+
+  iterator const_cast_iterator(const_iterator c_it) {
+    return begin() + std::distance(cbegin(), c_it);
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  flat_set() = default;
+  explicit flat_set(const key_compare& comp) : impl_{comp} {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  flat_set(I f, I l, const key_compare& comp = key_compare())
+      : impl_(comp, f, l) {
+    erase(sort_and_unique(begin(), end(), key_compare()), end());
+  }
+
+  // Sorts on up to p.num_threads threads.
+  template <typename I>
+  // requires InputIterator<I>
+  flat_set(parallel_t p, I f, I l, const key_compare& comp = key_compare())
+      : impl_(comp, f, l) {
+    erase(sort_and_unique_parallel(begin(), end(), key_compare(),
+                                   p.num_threads),
+          end());
+  }
+
+  flat_set(const flat_set&) = default;
+  flat_set(flat_set&&) = default;
+
+  explicit flat_set(underlying_type buf,
+                    const key_compare& comp = key_compare())
+      : impl_{comp, std::move(buf)} {
+    erase(sort_and_unique(begin(), end(), key_compare()), end());
+  }
+
+  flat_set(std::initializer_list<value_type> il,
+           const key_compare& comp = key_compare())
+      : flat_set(il.begin(), il.end(), comp) {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  flat_set(sorted_unique_t, I f, I l, const key_compare& comp = key_compare())
+      : impl_(comp, f, l) {
+    assert(detail::is_sorted_unique(begin(), end(), value_comp()));
+  }
+
+  flat_set(sorted_unique_t,
+           underlying_type buf,
+           const key_compare& comp = key_compare())
+      : impl_{comp, std::move(buf)} {
+    assert(detail::is_sorted_unique(begin(), end(), value_comp()));
+  }
+
+  // Union of the sorted and unique ranges from [f, l), with set_union_n.
+  template <typename RI>
+  // requires ForwardIterator<RI> && ForwardRange<ValueType<RI>>
+  flat_set(sorted_unique_ranges_t,
+           RI f,
+           RI l,
+           const key_compare& comp = key_compare())
+      : impl_{comp} {
+    size_type total = 0;
+    for (RI it = f; it != l; ++it)
+      total += static_cast<size_type>(std::distance(std::begin(*it),
+                                                    std::end(*it)));
+    body().reserve(total);
+    set_union_n(f, l, std::back_inserter(body()), value_comp());
+  }
+
+  flat_set(sorted_unique_t,
+           std::initializer_list<value_type> il,
+           const key_compare& comp = key_compare())
+      : flat_set(sorted_unique, il.begin(), il.end(), comp) {}
+
+  ~flat_set() = default;
+
+  // --------------------------------------------------------------------------
+  // Assignments --------------------------------------------------------------
+
+  flat_set& operator=(const flat_set&) = default;
+  flat_set& operator=(flat_set&&) = default;
+  flat_set& operator=(std::initializer_list<value_type> il) {
+    body() = il;
+    erase(sort_and_unique(begin(), end(), key_compare()), end());
+    return *this;
+  }
+
+  //---------------------------------------------------------------------------
+  // Memory management.
 
   void reserve(size_type new_capacity) { body().reserve(new_capacity); }
   size_type capacity() const { return body().capacity(); }
@@ -510,73 +2051,849 @@ class flat_set {
   //---------------------------------------------------------------------------
   // Size management.
 
-  void clear() { body().clear(); }
+  void clear() { body().clear(); }
+
+  size_type size() const { return body().size(); }
+  size_type max_size() const { return body().max_size(); }
+
+  bool empty() const { return body().empty(); }
+
+  //---------------------------------------------------------------------------
+  // Iterators.
+
+  iterator begin() { return body().begin(); }
+  const_iterator begin() const { return body().begin(); }
+  const_iterator cbegin() const { return body().cbegin(); }
+
+  iterator end() { return body().end(); }
+  const_iterator end() const { return body().end(); }
+  const_iterator cend() const { return body().cend(); }
+
+  reverse_iterator rbegin() { return body().rbegin(); }
+  const_reverse_iterator rbegin() const { return body().rbegin(); }
+  const_reverse_iterator crbegin() const { return body().crbegin(); }
+
+  reverse_iterator rend() { return body().rend(); }
+  const_reverse_iterator rend() const { return body().rend(); }
+  const_reverse_iterator crend() const { return body().crend(); }
+
+  //---------------------------------------------------------------------------
+  // Insert operations.
+
+  template <typename V,
+            typename = detail::insert_should_be_enabled<value_type, V>>
+  std::pair<iterator, bool> insert(V&& v) {
+    iterator pos = lower_bound(v);
+    if (pos == end() || value_comp()(v, *pos))
+      return {body().insert(pos, std::forward<V>(v)), true};
+    return {pos, false};
+  }
+
+  // Looks k up with the transparent comparator and constructs value_type
+  // from it only if it is not there: no allocations for the strings that
+  // are already in. value_type(k) has to be equivalent to k.
+  template <typename K,
+            detail::heterogeneous_insert_should_be_enabled<value_compare,
+                                                           value_type,
+                                                           K>* = nullptr>
+  std::pair<iterator, bool> insert(K&& k) {
+    return try_emplace(std::forward<K>(k));
+  }
+
+  // Same, value_type is constructed from (k, args...).
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace(K&& k, Args&&... args) {
+    iterator pos = lower_bound(k);
+    if (pos != end() && !value_comp()(k, *pos))
+      return {pos, false};
+    return {body().emplace(pos, std::forward<K>(k),
+                           std::forward<Args>(args)...),
+            true};
+  }
+
+  template <typename V,
+            typename = detail::insert_should_be_enabled<value_type, V>>
+  iterator insert(const_iterator hint, V&& v) {
+    const_iterator pos =
+        lower_bound_hinted(cbegin(), hint, cend(), v, value_comp());
+    if (pos == end()) {
+      body().push_back(std::forward<V>(v));
+      return std::prev(end());
+    }
+    if (value_comp()(v, *pos))
+      return body().insert(pos, std::forward<V>(v));
+    return const_cast_iterator(pos);
+  }
+
+  template <typename I>
+  void insert(I f, I l) {
+    detail::insert_first_last_impl(body(), f, l, value_comp());
+  }
+
+  // Sorts the new elements on up to p.num_threads threads.
+  template <typename I>
+  void insert(parallel_t p, I f, I l) {
+    detail::insert_first_last_impl(body(), f, l, value_comp(), p.num_threads);
+  }
+
+  // insert(f, l) that needs memory only for the inserted elements, at the
+  // cost of a slower merge. For big sets.
+  template <typename I>
+  void insert_in_place(I f, I l) {
+    detail::insert_first_last_in_place_impl(body(), f, l, value_comp());
+  }
+
+  template <typename I>
+  void insert(sorted_unique_t, I f, I l) {
+    detail::insert_sorted_unique_impl(
+        body(), f, l, value_comp(),
+        typename std::iterator_traits<I>::iterator_category{});
+  }
+
+  // Adds all of the elements of x. x is already sorted, so it is merged
+  // backward into the spare capacity: with enough of it there are no
+  // allocations. Merging a set into itself does nothing.
+  void merge(const flat_set& x) {
+    if (&x == this)
+      return;
+    insert(sorted_unique, x.begin(), x.end());
+  }
+
+  // Same, but elements are moved and, if x is bigger or only x has enough
+  // capacity, its buffer is taken over. x is left empty, unless it is *this.
+  void merge(flat_set&& x) {
+    if (&x == this)
+      return;
+    const size_type total = size() + x.size();
+    if (capacity() < total &&
+        (x.capacity() >= total || x.size() > size()))
+      body().swap(x.body());
+
+    insert(sorted_unique, std::make_move_iterator(x.begin()),
+           std::make_move_iterator(x.end()));
+    x.clear();
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return insert(value_type{std::forward<Args>(args)...});
+  }
+
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, Args&&... args) {
+    return insert(hint, value_type{std::forward<Args>(args)...});
+  }
+
+  // --------------------------------------------------------------------------
+  // Erase operations.
+
+  iterator erase(iterator pos) { return body().erase(pos); }
+  iterator erase(const_iterator pos) { return body().erase(pos); }
+
+  iterator erase(const_iterator f, const_iterator l) {
+    return body().erase(f, l);
+  }
+
+  template <typename V>
+  size_type erase(const V& v) {
+    auto eq_range = equal_range(v);
+    size_type res = std::distance(eq_range.first, eq_range.second);
+    erase(eq_range.first, eq_range.second);
+    return res;
+  }
+
+  // Keeps only the elements that are also in the sorted range [f, l).
+  // The vector is compacted in place, there are no allocations.
+  template <typename I>
+  // requires ForwardIterator<I>
+  void intersect_with(I f, I l) {
+    auto out = body().begin();
+    detail::set_intersection_unbalanced_impl(
+        body().begin(), body().end(), f, l, value_comp(),
+        [&](iterator run_f, iterator run_l) {
+          out = detail::move_left(run_f, run_l, out);
+        });
+    body().erase(out, body().end());
+  }
+
+  void intersect_with(const flat_set& x) { intersect_with(x.begin(), x.end()); }
+
+  // Removes the elements of the sorted range [f, l), in place.
+  template <typename I>
+  // requires ForwardIterator<I>
+  void subtract(I f, I l) {
+    auto out = body().begin();
+    detail::set_difference_unbalanced_impl(
+        body().begin(), body().end(), f, l, value_comp(),
+        [&](iterator run_f, iterator run_l) {
+          out = detail::move_left(run_f, run_l, out);
+        });
+    body().erase(out, body().end());
+  }
+
+  void subtract(const flat_set& x) { subtract(x.begin(), x.end()); }
+
+  // --------------------------------------------------------------------------
+  // Search operations.
+
+  template <typename V>
+  size_type count(const V& v) const {
+    auto eq_range = equal_range(v);
+    return std::distance(eq_range.first, eq_range.second);
+  }
+
+  template <typename V>
+  iterator find(const V& v) {
+    auto eq_range = equal_range(v);
+    return (eq_range.first == eq_range.second) ? end() : eq_range.first;
+  }
+
+  template <typename V>
+  const_iterator find(const V& v) const {
+    auto eq_range = equal_range(v);
+    return (eq_range.first == eq_range.second) ? end() : eq_range.first;
+  }
+
+  template <typename V>
+  std::pair<iterator, iterator> equal_range(const V& v) {
+    auto pos = lower_bound(v);
+    if (pos == end() || value_comp()(v, *pos))
+      return {pos, pos};
+
+    return {pos, std::next(pos)};
+  }
+
+  template <typename V>
+  std::pair<const_iterator, const_iterator> equal_range(const V& v) const {
+    auto pos = lower_bound(v);
+    if (pos == end() || value_comp()(v, *pos))
+      return {pos, pos};
+
+    return {pos, std::next(pos)};
+  }
+
+  template <typename V>
+  iterator lower_bound(const V& v) {
+    const type_for_value_compare<V>& v_ref = v;
+    return search_policy{}.lower_bound(begin(), end(), v_ref, value_comp());
+  }
+
+  template <typename V>
+  const_iterator lower_bound(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    return search_policy{}.lower_bound(begin(), end(), v_ref, value_comp());
+  }
+
+  template <typename V>
+  iterator upper_bound(const V& v) {
+    const type_for_value_compare<V>& v_ref = v;
+    return search_policy{}.upper_bound(begin(), end(), v_ref, value_comp());
+  }
+
+  template <typename V>
+  const_iterator upper_bound(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    return search_policy{}.upper_bound(begin(), end(), v_ref, value_comp());
+  }
+
+  // Lookups of many unsorted keys. Outputs const_iterators in the order of
+  // the queries. Is much faster than a loop for sets that do not fit in the
+  // cache.
+  template <typename I, typename O>
+  // requires ForwardIterator<I> && OutputIterator<O, const_iterator>
+  O lower_bound_batch(I f, I l, O o) const {
+    return lib::lower_bound_batch(begin(), end(), f, l, o, value_comp());
+  }
+
+  template <typename I, typename O>
+  // requires ForwardIterator<I> && OutputIterator<O, const_iterator>
+  O find_batch(I f, I l, O o) const {
+    return lib::find_batch(begin(), end(), f, l, o, value_comp());
+  }
+
+  // For queries in the ascending order: every next search starts from the
+  // previous answer. Invalidated together with iterators.
+  finger_searcher<const_iterator, value_compare> searcher() const {
+    return {begin(), end(), value_comp()};
+  }
+
+  //---------------------------------------------------------------------------
+  // Getters.
+
+  key_compare key_comp() const { return impl_; }
+  value_compare value_comp() const { return impl_; }
+
+  underlying_type& body() { return impl_.body_; }
+  const underlying_type& body() const { return impl_.body_; }
+
+  //---------------------------------------------------------------------------
+  // General operations.
+
+  void swap(flat_set& x) { body().swap(x.body()); }
+
+  friend void swap(flat_set& x, flat_set& y) { x.swap(y); }
+
+  friend bool operator==(const flat_set& x, const flat_set& y) {
+    return x.body() == y.body();
+  }
+
+  friend bool operator!=(const flat_set& x, const flat_set& y) {
+    return !(x == y);
+  }
+
+  friend bool operator<(const flat_set& x, const flat_set& y) {
+    return x.body() < y.body();
+  }
+
+  friend bool operator>(const flat_set& x, const flat_set& y) { return y < x; }
+
+  friend bool operator<=(const flat_set& x, const flat_set& y) {
+    return !(y < x);
+  }
+
+  friend bool operator>=(const flat_set& x, const flat_set& y) {
+    return !(x < y);
+  }
+};
+
+template <typename Key,
+          typename Comparator,
+          typename UnderlyingType,
+          typename SearchPolicy,
+          typename P>
+// requires UnaryPredicate<P(reference)>
+void erase_if(flat_set<Key, Comparator, UnderlyingType, SearchPolicy>& x,
+              P p) {
+  x.erase(std::remove_if(x.begin(), x.end(), p), x.end());
+}
+
+// flat_map -------------------------------------------------------------------
+
+namespace detail {
+
+template <typename Reference>
+struct arrow_proxy {
+  Reference ref;
+
+  Reference* operator->() { return &ref; }
+};
+
+// Iterates keys and values that live in two different containers.
+// Dereferencing produces a pair of references.
+
+template <typename KeyIterator, typename MappedIterator>
+class split_storage_iterator {
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type =
+      std::pair<ValueType<KeyIterator>, ValueType<MappedIterator>>;
+  using difference_type = DifferenceType<KeyIterator>;
+  using reference =
+      std::pair<Reference<KeyIterator>, Reference<MappedIterator>>;
+  using pointer = arrow_proxy<reference>;
+
+  split_storage_iterator() = default;
+  split_storage_iterator(KeyIterator key, MappedIterator mapped)
+      : key_(key), mapped_(mapped) {}
+
+  // iterator -> const_iterator
+  template <typename K,
+            typename M,
+            typename = typename std::enable_if<
+                std::is_convertible<K, KeyIterator>::value &&
+                std::is_convertible<M, MappedIterator>::value>::type>
+  split_storage_iterator(const split_storage_iterator<K, M>& x)
+      : key_(x.key_iterator()), mapped_(x.mapped_iterator()) {}
+
+  KeyIterator key_iterator() const { return key_; }
+  MappedIterator mapped_iterator() const { return mapped_; }
+
+  reference operator*() const { return {*key_, *mapped_}; }
+  pointer operator->() const { return {**this}; }
+  reference operator[](difference_type n) const { return *(*this + n); }
+
+  split_storage_iterator& operator++() {
+    ++key_;
+    ++mapped_;
+    return *this;
+  }
+
+  split_storage_iterator operator++(int) {
+    auto res = *this;
+    ++*this;
+    return res;
+  }
+
+  split_storage_iterator& operator--() {
+    --key_;
+    --mapped_;
+    return *this;
+  }
+
+  split_storage_iterator operator--(int) {
+    auto res = *this;
+    --*this;
+    return res;
+  }
+
+  split_storage_iterator& operator+=(difference_type n) {
+    key_ += n;
+    mapped_ += n;
+    return *this;
+  }
+
+  split_storage_iterator& operator-=(difference_type n) {
+    return *this += -n;
+  }
+
+  friend split_storage_iterator operator+(split_storage_iterator x,
+                                          difference_type n) {
+    return x += n;
+  }
+
+  friend split_storage_iterator operator+(difference_type n,
+                                          split_storage_iterator x) {
+    return x += n;
+  }
+
+  friend split_storage_iterator operator-(split_storage_iterator x,
+                                          difference_type n) {
+    return x -= n;
+  }
+
+  friend difference_type operator-(const split_storage_iterator& x,
+                                   const split_storage_iterator& y) {
+    return x.key_ - y.key_;
+  }
+
+  friend bool operator==(const split_storage_iterator& x,
+                         const split_storage_iterator& y) {
+    return x.key_ == y.key_;
+  }
+
+  friend bool operator!=(const split_storage_iterator& x,
+                         const split_storage_iterator& y) {
+    return !(x == y);
+  }
+
+  friend bool operator<(const split_storage_iterator& x,
+                        const split_storage_iterator& y) {
+    return x.key_ < y.key_;
+  }
+
+  friend bool operator>(const split_storage_iterator& x,
+                        const split_storage_iterator& y) {
+    return y < x;
+  }
+
+  friend bool operator<=(const split_storage_iterator& x,
+                         const split_storage_iterator& y) {
+    return !(y < x);
+  }
+
+  friend bool operator>=(const split_storage_iterator& x,
+                         const split_storage_iterator& y) {
+    return !(x < y);
+  }
+
+ private:
+  KeyIterator key_;
+  MappedIterator mapped_;
+};
+
+// Sorts keys and applies the same permutation to values.
+// From equal keys the first one wins, same as for inserting one by one.
+template <typename KC, typename MC, typename P>
+// requires Container<KC> && Container<MC> &&
+//          StrictWeakOrdering<P(ValueType<KC>)>
+void sort_and_unique_split_storage(KC& keys, MC& values, P p) {
+  assert(keys.size() == values.size());
+  using index = typename KC::size_type;
+  using key_ref = typename KC::const_reference;
+
+  auto not_less = [&](key_ref x, key_ref y) { return !p(x, y); };
+  if (std::adjacent_find(keys.begin(), keys.end(), not_less) == keys.end())
+    return;
+
+  std::vector<index> permutation(keys.size());
+  std::iota(permutation.begin(), permutation.end(), index(0));
+  std::stable_sort(permutation.begin(), permutation.end(),
+                   [&](index x, index y) { return p(keys[x], keys[y]); });
+  permutation.erase(
+      std::unique(permutation.begin(), permutation.end(),
+                  [&](index x, index y) { return !p(keys[x], keys[y]); }),
+      permutation.end());
+
+  KC sorted_keys;
+  MC sorted_values;
+  sorted_keys.reserve(permutation.size());
+  sorted_values.reserve(permutation.size());
+  for (index i : permutation) {
+    sorted_keys.push_back(std::move(keys[i]));
+    sorted_values.push_back(std::move(values[i]));
+  }
+
+  keys = std::move(sorted_keys);
+  values = std::move(sorted_values);
+}
+
+// Both inputs have to be sorted and unique. Keys that are already in the map
+// keep their values.
+template <typename KC, typename MC, typename P>
+// requires Container<KC> && Container<MC> &&
+//          StrictWeakOrdering<P(ValueType<KC>)>
+void merge_split_storage(KC& keys,
+                         MC& values,
+                         KC& new_keys,
+                         MC& new_values,
+                         P p) {
+  using index = typename KC::size_type;
+
+  // Both sequences are sorted, so every search starts from the previous
+  // result.
+  index new_len = 0;
+  {
+    lower_bounds_t<Iterator<KC>, P> searcher(keys.begin(), keys.end(), p);
+    for (index i = 0; i < new_keys.size(); ++i) {
+      if (searcher.f() != searcher.l()) {
+        auto pos = searcher(new_keys[i]);
+        if (pos != keys.end() && !p(new_keys[i], *pos))
+          continue;
+      }
+      if (new_len != i) {
+        new_keys[new_len] = std::move(new_keys[i]);
+        new_values[new_len] = std::move(new_values[i]);
+      }
+      ++new_len;
+    }
+  }
+
+  if (!new_len)
+    return;
+
+  const index orig_len = keys.size();
+  keys.resize(orig_len + new_len);
+  values.resize(orig_len + new_len);
+
+  // Going backwards: every new element is preceded by a block of old ones
+  // that have to be shifted to the right.
+  using reverse_it = typename KC::reverse_iterator;
+  lower_bounds_t<reverse_it, inverse_t<P>> searcher(
+      reverse_it(keys.begin() + orig_len), keys.rend(), inverse_fn(p));
+
+  index out = keys.size();
+  for (index i = new_len; i--;) {
+    index hi = searcher.f().base() - keys.begin();
+    index lo = hi;
+    if (searcher.f() != searcher.l())
+      lo = searcher(new_keys[i]).base() - keys.begin();
+
+    std::move_backward(keys.begin() + lo, keys.begin() + hi,
+                       keys.begin() + out);
+    std::move_backward(values.begin() + lo, values.begin() + hi,
+                       values.begin() + out);
+    out -= hi - lo + 1;
+    keys[out] = std::move(new_keys[i]);
+    values[out] = std::move(new_values[i]);
+  }
+}
+
+}  // namespace detail
+
+// Keys and values are stored in separate containers, so the binary search
+// only touches the keys (see separation_between_keys_and_values.cc).
+template <typename Key,
+          typename Mapped,
+          typename Comparator = less,
+          typename KeyContainer = std::vector<Key>,
+          typename MappedContainer = std::vector<Mapped>>
+// requires (todo)
+class flat_map {
+ public:
+  using key_container_type = KeyContainer;
+  using mapped_container_type = MappedContainer;
+  using key_type = Key;
+  using mapped_type = Mapped;
+  using value_type = std::pair<key_type, mapped_type>;
+  using size_type = typename key_container_type::size_type;
+  using difference_type = typename key_container_type::difference_type;
+  using key_compare = Comparator;
+  using iterator = detail::split_storage_iterator<
+      typename key_container_type::const_iterator,
+      typename mapped_container_type::iterator>;
+  using const_iterator = detail::split_storage_iterator<
+      typename key_container_type::const_iterator,
+      typename mapped_container_type::const_iterator>;
+  using reference = typename iterator::reference;
+  using const_reference = typename const_iterator::reference;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+ private:
+  struct impl_t : key_compare {
+    impl_t() = default;
+
+    explicit impl_t(key_compare comp) : key_compare(comp) {}
+
+    impl_t(key_compare comp,
+           key_container_type keys,
+           mapped_container_type values)
+        : key_compare(comp),
+          keys_(std::move(keys)),
+          values_(std::move(values)) {}
+
+    key_container_type keys_;
+    mapped_container_type values_;
+  }
+  impl_;
+
+  using key_iterator = typename key_container_type::const_iterator;
+
+  template <typename V>
+  using type_for_key_compare =
+      typename std::conditional<TransparentComparator<key_compare>(),
+                                V,
+                                key_type>::type;
+
+  iterator make_iterator(key_iterator it) {
+    return {it, values().begin() + std::distance(keys().cbegin(), it)};
+  }
+
+  const_iterator make_iterator(key_iterator it) const {
+    return {it, values().begin() + std::distance(keys().cbegin(), it)};
+  }
+
+  template <typename V>
+  key_iterator key_lower_bound(const V& v) const {
+    const type_for_key_compare<V>& v_ref = v;
+    return lib::lower_bound(keys().begin(), keys().end(), v_ref, key_comp());
+  }
+
+  template <typename V>
+  key_iterator key_upper_bound(const V& v) const {
+    const type_for_key_compare<V>& v_ref = v;
+    return std::upper_bound(keys().begin(), keys().end(), v_ref, key_comp());
+  }
+
+  template <typename V>
+  key_iterator key_find(const V& v) const {
+    auto pos = key_lower_bound(v);
+    if (pos == keys().end() || key_comp()(v, *pos))
+      return keys().end();
+    return pos;
+  }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace_impl(K&& k, Args&&... args) {
+    auto pos = key_lower_bound(k);
+    if (pos != keys().end() && !key_comp()(k, *pos))
+      return {make_iterator(pos), false};
+
+    auto idx = std::distance(keys().cbegin(), pos);
+    keys().emplace(pos, std::forward<K>(k));
+    try {
+      values().emplace(values().begin() + idx, std::forward<Args>(args)...);
+    } catch (...) {
+      keys().erase(keys().begin() + idx);
+      throw;
+    }
+    return {begin() + idx, true};
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  flat_map() = default;
+  explicit flat_map(const key_compare& comp) : impl_{comp} {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  flat_map(I f, I l, const key_compare& comp = key_compare()) : impl_{comp} {
+    for (; f != l; ++f) {
+      keys().push_back((*f).first);
+      values().push_back((*f).second);
+    }
+    detail::sort_and_unique_split_storage(keys(), values(), key_comp());
+  }
+
+  flat_map(const flat_map&) = default;
+  flat_map(flat_map&&) = default;
+
+  flat_map(key_container_type keys,
+           mapped_container_type values,
+           const key_compare& comp = key_compare())
+      : impl_{comp, std::move(keys), std::move(values)} {
+    detail::sort_and_unique_split_storage(this->keys(), this->values(),
+                                          key_comp());
+  }
+
+  flat_map(std::initializer_list<value_type> il,
+           const key_compare& comp = key_compare())
+      : flat_map(il.begin(), il.end(), comp) {}
+
+  ~flat_map() = default;
+
+  // --------------------------------------------------------------------------
+  // Assignments --------------------------------------------------------------
+
+  flat_map& operator=(const flat_map&) = default;
+  flat_map& operator=(flat_map&&) = default;
+  flat_map& operator=(std::initializer_list<value_type> il) {
+    *this = flat_map(il, key_comp());
+    return *this;
+  }
+
+  //---------------------------------------------------------------------------
+  // Memory management.
+
+  void reserve(size_type new_capacity) {
+    keys().reserve(new_capacity);
+    values().reserve(new_capacity);
+  }
+
+  size_type capacity() const {
+    return std::min(keys().capacity(), values().capacity());
+  }
+
+  void shrink_to_fit() {
+    keys().shrink_to_fit();
+    values().shrink_to_fit();
+  }
+
+  //---------------------------------------------------------------------------
+  // Size management.
+
+  void clear() {
+    keys().clear();
+    values().clear();
+  }
 
-  size_type size() const { return body().size(); }
-  size_type max_size() const { return body().max_size(); }
+  size_type size() const { return keys().size(); }
+  size_type max_size() const { return keys().max_size(); }
 
-  bool empty() const { return body().empty(); }
+  bool empty() const { return keys().empty(); }
 
   //---------------------------------------------------------------------------
   // Iterators.
 
-  iterator begin() { return body().begin(); }
-  const_iterator begin() const { return body().begin(); }
-  const_iterator cbegin() const { return body().cbegin(); }
+  iterator begin() { return {keys().cbegin(), values().begin()}; }
+  const_iterator begin() const { return {keys().cbegin(), values().cbegin()}; }
+  const_iterator cbegin() const { return begin(); }
 
-  iterator end() { return body().end(); }
-  const_iterator end() const { return body().end(); }
-  const_iterator cend() const { return body().cend(); }
+  iterator end() { return {keys().cend(), values().end()}; }
+  const_iterator end() const { return {keys().cend(), values().cend()}; }
+  const_iterator cend() const { return end(); }
 
-  reverse_iterator rbegin() { return body().rbegin(); }
-  const_reverse_iterator rbegin() const { return body().rbegin(); }
-  const_reverse_iterator crbegin() const { return body().crbegin(); }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator crbegin() const { return rbegin(); }
 
-  reverse_iterator rend() { return body().rend(); }
-  const_reverse_iterator rend() const { return body().rend(); }
-  const_reverse_iterator crend() const { return body().crend(); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+  const_reverse_iterator crend() const { return rend(); }
+
+  //---------------------------------------------------------------------------
+  // Element access.
+
+  mapped_type& operator[](const key_type& k) {
+    return (*try_emplace(k).first).second;
+  }
+
+  mapped_type& operator[](key_type&& k) {
+    return (*try_emplace(std::move(k)).first).second;
+  }
+
+  template <typename V>
+  mapped_type& at(const V& v) {
+    auto pos = key_find(v);
+    if (pos == keys().end())
+      throw std::out_of_range("lib::flat_map::at");
+    return (*make_iterator(pos)).second;
+  }
+
+  template <typename V>
+  const mapped_type& at(const V& v) const {
+    auto pos = key_find(v);
+    if (pos == keys().end())
+      throw std::out_of_range("lib::flat_map::at");
+    return (*make_iterator(pos)).second;
+  }
 
   //---------------------------------------------------------------------------
   // Insert operations.
 
-  template <typename V,
-            typename = detail::insert_should_be_enabled<value_type, V>>
-  std::pair<iterator, bool> insert(V&& v) {
-    iterator pos = lower_bound(v);
-    if (pos == end() || value_comp()(v, *pos))
-      return {body().insert(pos, std::forward<V>(v)), true};
-    return {pos, false};
+  std::pair<iterator, bool> insert(const value_type& v) {
+    return try_emplace(v.first, v.second);
   }
 
-  template <typename V,
-            typename = detail::insert_should_be_enabled<value_type, V>>
-  iterator insert(const_iterator hint, V&& v) {
+  std::pair<iterator, bool> insert(value_type&& v) {
+    return try_emplace(std::move(v.first), std::move(v.second));
+  }
+
+  iterator insert(const_iterator hint, const value_type& v) {
     return insert(v).first;
   }
 
+  iterator insert(const_iterator hint, value_type&& v) {
+    return insert(std::move(v)).first;
+  }
+
+  // Values are permuted alongside keys, new keys are merged in with
+  // the galloping search.
   template <typename I>
   void insert(I f, I l) {
-    detail::insert_first_last_impl(body(), f, l, value_comp());
+    key_container_type new_keys;
+    mapped_container_type new_values;
+    for (; f != l; ++f) {
+      new_keys.push_back((*f).first);
+      new_values.push_back((*f).second);
+    }
+
+    detail::sort_and_unique_split_storage(new_keys, new_values, key_comp());
+    detail::merge_split_storage(keys(), values(), new_keys, new_values,
+                                key_comp());
   }
 
   template <typename... Args>
   std::pair<iterator, bool> emplace(Args&&... args) {
-    return insert(value_type{std::forward<Args>(args)...});
+    return insert(value_type(std::forward<Args>(args)...));
   }
 
   template <typename... Args>
   iterator emplace_hint(const_iterator hint, Args&&... args) {
-    return insert(hint, value_type{std::forward<Args>(args)...});
+    return emplace(std::forward<Args>(args)...).first;
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& k, Args&&... args) {
+    return try_emplace_impl(k, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(key_type&& k, Args&&... args) {
+    return try_emplace_impl(std::move(k), std::forward<Args>(args)...);
   }
 
   // --------------------------------------------------------------------------
   // Erase operations.
 
-  iterator erase(iterator pos) { return body().erase(pos); }
-  iterator erase(const_iterator pos) { return body().erase(pos); }
+  iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+  iterator erase(const_iterator pos) {
+    return erase(pos, std::next(pos));
+  }
 
   iterator erase(const_iterator f, const_iterator l) {
-    return body().erase(f, l);
+    auto idx = std::distance(cbegin(), f);
+    auto len = std::distance(f, l);
+    keys().erase(keys().begin() + idx, keys().begin() + idx + len);
+    values().erase(values().begin() + idx, values().begin() + idx + len);
+    return begin() + idx;
   }
 
   template <typename V>
@@ -592,26 +2909,23 @@ class flat_set {
 
   template <typename V>
   size_type count(const V& v) const {
-    auto eq_range = equal_range(v);
-    return std::distance(eq_range.first, eq_range.second);
+    return key_find(v) == keys().end() ? 0 : 1;
   }
 
   template <typename V>
   iterator find(const V& v) {
-    auto eq_range = equal_range(v);
-    return (eq_range.first == eq_range.second) ? end() : eq_range.first;
+    return make_iterator(key_find(v));
   }
 
   template <typename V>
   const_iterator find(const V& v) const {
-    auto eq_range = equal_range(v);
-    return (eq_range.first == eq_range.second) ? end() : eq_range.first;
+    return make_iterator(key_find(v));
   }
 
   template <typename V>
   std::pair<iterator, iterator> equal_range(const V& v) {
     auto pos = lower_bound(v);
-    if (pos == end() || value_comp()(v, *pos))
+    if (pos == end() || key_comp()(v, (*pos).first))
       return {pos, pos};
 
     return {pos, std::next(pos)};
@@ -620,7 +2934,7 @@ class flat_set {
   template <typename V>
   std::pair<const_iterator, const_iterator> equal_range(const V& v) const {
     auto pos = lower_bound(v);
-    if (pos == end() || value_comp()(v, *pos))
+    if (pos == end() || key_comp()(v, (*pos).first))
       return {pos, pos};
 
     return {pos, std::next(pos)};
@@ -628,74 +2942,96 @@ class flat_set {
 
   template <typename V>
   iterator lower_bound(const V& v) {
-    const type_for_value_compare<V>& v_ref = v;
-    return std::lower_bound(begin(), end(), v_ref, value_comp());
+    return make_iterator(key_lower_bound(v));
   }
 
   template <typename V>
   const_iterator lower_bound(const V& v) const {
-    const type_for_value_compare<V>& v_ref = v;
-    return std::lower_bound(begin(), end(), v_ref, value_comp());
+    return make_iterator(key_lower_bound(v));
   }
 
   template <typename V>
   iterator upper_bound(const V& v) {
-    const type_for_value_compare<V>& v_ref = v;
-    return std::upper_bound(begin(), end(), v_ref, value_comp());
+    return make_iterator(key_upper_bound(v));
   }
 
   template <typename V>
   const_iterator upper_bound(const V& v) const {
-    const type_for_value_compare<V>& v_ref = v;
-    return std::upper_bound(begin(), end(), v_ref, value_comp());
+    return make_iterator(key_upper_bound(v));
   }
 
   //---------------------------------------------------------------------------
   // Getters.
 
   key_compare key_comp() const { return impl_; }
-  value_compare value_comp() const { return impl_; }
 
-  underlying_type& body() { return impl_.body_; }
-  const underlying_type& body() const { return impl_.body_; }
+  key_container_type& keys() { return impl_.keys_; }
+  const key_container_type& keys() const { return impl_.keys_; }
+
+  mapped_container_type& values() { return impl_.values_; }
+  const mapped_container_type& values() const { return impl_.values_; }
 
   //---------------------------------------------------------------------------
   // General operations.
 
-  void swap(flat_set& x) { body().swap(x.body()); }
+  void swap(flat_map& x) {
+    keys().swap(x.keys());
+    values().swap(x.values());
+  }
 
-  friend void swap(flat_set& x, flat_set& y) { x.swap(y); }
+  friend void swap(flat_map& x, flat_map& y) { x.swap(y); }
 
-  friend bool operator==(const flat_set& x, const flat_set& y) {
-    return x.body() == y.body();
+  friend bool operator==(const flat_map& x, const flat_map& y) {
+    return x.keys() == y.keys() && x.values() == y.values();
   }
 
-  friend bool operator!=(const flat_set& x, const flat_set& y) {
+  friend bool operator!=(const flat_map& x, const flat_map& y) {
     return !(x == y);
   }
 
-  friend bool operator<(const flat_set& x, const flat_set& y) {
-    return x.body() < y.body();
+  friend bool operator<(const flat_map& x, const flat_map& y) {
+    return std::lexicographical_compare(x.begin(), x.end(), y.begin(),
+                                        y.end());
   }
 
-  friend bool operator>(const flat_set& x, const flat_set& y) { return y < x; }
+  friend bool operator>(const flat_map& x, const flat_map& y) { return y < x; }
 
-  friend bool operator<=(const flat_set& x, const flat_set& y) {
+  friend bool operator<=(const flat_map& x, const flat_map& y) {
     return !(y < x);
   }
 
-  friend bool operator>=(const flat_set& x, const flat_set& y) {
+  friend bool operator>=(const flat_map& x, const flat_map& y) {
     return !(x < y);
   }
 };
 
 template <typename Key,
+          typename Mapped,
           typename Comparator,
-          typename UnderlyingType,
+          typename KeyContainer,
+          typename MappedContainer,
           typename P>
 // requires UnaryPredicate<P(reference)>
-void erase_if(flat_set<Key, Comparator, UnderlyingType>& x, P p) {
-  x.erase(std::remove_if(x.begin(), x.end(), p), x.end());
+void erase_if(
+    flat_map<Key, Mapped, Comparator, KeyContainer, MappedContainer>& x,
+    P p) {
+  auto& keys = x.keys();
+  auto& values = x.values();
+
+  typename KeyContainer::size_type out = 0;
+  for (auto it = x.begin(); it != x.end(); ++it) {
+    if (p(*it))
+      continue;
+    auto idx = std::distance(x.begin(), it);
+    if (out != static_cast<decltype(out)>(idx)) {
+      keys[out] = std::move(keys[idx]);
+      values[out] = std::move(values[idx]);
+    }
+    ++out;
+  }
+
+  keys.erase(keys.begin() + out, keys.end());
+  values.erase(values.begin() + out, values.end());
 }
 
 }  // namespace lib
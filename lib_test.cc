@@ -7,12 +7,25 @@
 #include <string>
 
 #include "lib.h"
+#include "buffered_flat_set.h"
+#include "cow_flat_set.h"
+#include "eytzinger_set.h"
+#include "leveled_flat_set.h"
+#include "rcu_flat_set.h"
+#include "segmented_flat_set.h"
+#include "sharded_flat_set.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <limits>
+#include <map>
 #include <numeric>
 #include <random>
 #include <set>
+#include <sstream>
+#include <thread>
 #include <vector>
 
 namespace {
@@ -127,6 +140,428 @@ TEST_CASE("set_union_unbalanced", "[merge_algorithms]") {
   test({1, 2, 3, 6, 7}, {4, 6}, {1, 2, 3, 4, 6, 7});
 }
 
+TEST_CASE("set_union_parallel", "[merge_algorithms]") {
+  std::mt19937 g;
+
+  auto random_set = [&](size_t size, int max) {
+    std::uniform_int_distribution<> dis(0, max);
+    int_vec res(size);
+    std::generate(res.begin(), res.end(), [&] { return dis(g); });
+    res.erase(lib::sort_and_unique(res.begin(), res.end()), res.end());
+    return res;
+  };
+
+  auto test = [](const int_vec& lhs, const int_vec& rhs) {
+    int_vec expected;
+    std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                   std::back_inserter(expected));
+
+    for (size_t threads : {1, 2, 3, 7, 16}) {
+      int_vec actual(lhs.size() + rhs.size());
+      actual.erase(
+          lib::set_union_parallel(lhs.begin(), lhs.end(), rhs.begin(),
+                                  rhs.end(), actual.begin(), lib::less{},
+                                  threads),
+          actual.end());
+      REQUIRE(expected == actual);
+    }
+  };
+
+  const size_t big = lib::kParallelSetUnionThreshold * 2;
+
+  test(random_set(big, 1 << 30), random_set(big, 1 << 30));
+  // Mostly duplicates.
+  test(random_set(big, big / 2), random_set(big, big / 2));
+  test(random_set(big, big), random_set(10, big));
+  test(random_set(big, big), {});
+
+  int_vec same = random_set(big, 1 << 30);
+  test(same, same);
+
+  int_vec first_half(big), second_half(big);
+  std::iota(first_half.begin(), first_half.end(), 0);
+  std::iota(second_half.begin(), second_half.end(), static_cast<int>(big));
+  test(first_half, second_half);
+  test(second_half, first_half);
+}
+
+TEST_CASE("other_set_operations_unbalanced", "[merge_algorithms]") {
+  std::mt19937 g;
+
+  auto random_set = [&](size_t size, int max) {
+    std::uniform_int_distribution<> dis(0, max);
+    int_vec res(size);
+    std::generate(res.begin(), res.end(), [&] { return dis(g); });
+    res.erase(lib::sort_and_unique(res.begin(), res.end()), res.end());
+    return res;
+  };
+
+  auto test = [](const int_vec& lhs, const int_vec& rhs) {
+    int_vec expected, actual;
+
+    std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                          std::back_inserter(expected));
+    lib::set_intersection_unbalanced(lhs.begin(), lhs.end(), rhs.begin(),
+                                     rhs.end(), std::back_inserter(actual));
+    REQUIRE(expected == actual);
+
+    lib::flat_set<int> in_place(lhs.begin(), lhs.end());
+    in_place.intersect_with(rhs.begin(), rhs.end());
+    REQUIRE(expected == in_place.body());
+
+    expected.clear();
+    actual.clear();
+    std::set_difference(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                        std::back_inserter(expected));
+    lib::set_difference_unbalanced(lhs.begin(), lhs.end(), rhs.begin(),
+                                   rhs.end(), std::back_inserter(actual));
+    REQUIRE(expected == actual);
+
+    in_place = lib::flat_set<int>(lhs.begin(), lhs.end());
+    in_place.subtract(rhs.begin(), rhs.end());
+    REQUIRE(expected == in_place.body());
+
+    expected.clear();
+    actual.clear();
+    std::set_symmetric_difference(lhs.begin(), lhs.end(), rhs.begin(),
+                                  rhs.end(), std::back_inserter(expected));
+    lib::set_symmetric_difference_unbalanced(lhs.begin(), lhs.end(),
+                                             rhs.begin(), rhs.end(),
+                                             std::back_inserter(actual));
+    REQUIRE(expected == actual);
+  };
+
+  test({}, {});
+  test({1}, {});
+  test({}, {1});
+  test({1}, {1});
+  test({1, 3}, {2});
+  test({1, 3, 4}, {2, 4});
+  test({1, 2, 3, 6, 7}, {4, 6});
+
+  for (size_t lhs_size : {0, 1, 5, 100, 2000}) {
+    for (size_t rhs_size : {0, 1, 5, 100, 2000}) {
+      for (int max : {10, 1000, 100000}) {
+        test(random_set(lhs_size, max), random_set(rhs_size, max));
+      }
+    }
+  }
+
+  int_vec same = random_set(1000, 1 << 20);
+  test(same, same);
+}
+
+TEST_CASE("set_union_n", "[merge_algorithms]") {
+  std::mt19937 g;
+
+  auto test = [](const std::vector<int_vec>& ranges) {
+    std::set<int> expected_set;
+    for (const auto& r : ranges)
+      expected_set.insert(r.begin(), r.end());
+    int_vec expected(expected_set.begin(), expected_set.end());
+
+    int_vec actual;
+    lib::set_union_n(ranges.begin(), ranges.end(),
+                     std::back_inserter(actual));
+    REQUIRE(expected == actual);
+
+    lib::flat_set<int> c(lib::sorted_unique_ranges, ranges.begin(),
+                         ranges.end());
+    REQUIRE(expected == c.body());
+  };
+
+  test({});
+  test({{}});
+  test({{1, 2, 3}});
+  test({{}, {1}, {}});
+  test({{1, 3}, {2}, {1, 2, 3}});
+
+  auto random_ranges = [&](size_t k, size_t size, int max) {
+    std::uniform_int_distribution<> dis(0, max);
+    std::vector<int_vec> res(k);
+    for (auto& r : res) {
+      r.resize(size);
+      std::generate(r.begin(), r.end(), [&] { return dis(g); });
+      r.erase(lib::sort_and_unique(r.begin(), r.end()), r.end());
+    }
+    return res;
+  };
+
+  for (size_t k : {2, 3, 7, 16, 33}) {
+    for (size_t size : {0, 1, 10, 500}) {
+      for (int max : {10, 1000, 1 << 20})
+        test(random_ranges(k, size, max));
+    }
+  }
+
+  // Long streaks: every range is a block of its own.
+  std::vector<int_vec> blocks(10);
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    blocks[i].resize(100);
+    std::iota(blocks[i].begin(), blocks[i].end(),
+              static_cast<int>((blocks.size() - i) * 50));
+  }
+  test(blocks);
+
+  // Equal elements come from the first range.
+  using pair_t = std::pair<int, int>;
+  auto by_first = [](const pair_t& x, const pair_t& y) {
+    return x.first < y.first;
+  };
+  std::vector<std::vector<pair_t>> tagged = {{{1, 0}, {3, 0}},
+                                             {{1, 1}, {2, 1}, {3, 1}}};
+  std::vector<pair_t> actual;
+  lib::set_union_n(tagged.begin(), tagged.end(), std::back_inserter(actual),
+                   by_first);
+  REQUIRE(actual == std::vector<pair_t>({{1, 0}, {2, 1}, {3, 0}}));
+}
+
+TEST_CASE("flat_set_in_place_set_operations", "[flat_cainers, flat_set]") {
+  using string_set = lib::flat_set<std::string>;
+
+  string_set c{"a", "b", "c", "d"};
+  const auto* data = c.body().data();
+  c.subtract(string_set{"b", "x"});
+  REQUIRE(c == string_set({"a", "c", "d"}));
+  c.intersect_with(string_set{"0", "c", "d", "e"});
+  REQUIRE(c == string_set({"c", "d"}));
+  REQUIRE(c.body().data() == data);
+
+  c.intersect_with(c);
+  REQUIRE(c == string_set({"c", "d"}));
+  c.subtract(c);
+  REQUIRE(c.empty());
+}
+
+// The searches must not look at the elements that were already moved:
+// moved from value sorts after everything.
+struct moved_from_max {
+  int x = 0;
+
+  moved_from_max() = default;
+  moved_from_max(int x) : x(x) {}
+  moved_from_max(const moved_from_max&) = default;
+  moved_from_max(moved_from_max&& y) noexcept : x(y.x) {
+    y.x = std::numeric_limits<int>::max();
+  }
+  moved_from_max& operator=(const moved_from_max&) = default;
+  moved_from_max& operator=(moved_from_max&& y) noexcept {
+    x = y.x;
+    y.x = std::numeric_limits<int>::max();
+    return *this;
+  }
+
+  friend bool operator<(const moved_from_max& a, const moved_from_max& b) {
+    return a.x < b.x;
+  }
+  friend bool operator==(const moved_from_max& a, const moved_from_max& b) {
+    return a.x == b.x;
+  }
+};
+
+TEST_CASE("flat_set_in_place_set_operations_moved_from",
+          "[flat_cainers, flat_set]") {
+  using set = lib::flat_set<moved_from_max>;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 300);
+  auto random_set = [&](size_t size) {
+    std::vector<moved_from_max> res(size);
+    for (auto& x : res)
+      x = dis(g);
+    return set(res.begin(), res.end());
+  };
+
+  for (size_t lhs_size : {1u, 10u, 100u, 200u}) {
+    for (size_t rhs_size : {1u, 10u, 100u, 200u}) {
+      const set lhs = random_set(lhs_size);
+      const set rhs = random_set(rhs_size);
+
+      std::vector<moved_from_max> expected;
+      std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                            std::back_inserter(expected));
+      set c = lhs;
+      c.intersect_with(rhs);
+      REQUIRE(c.body() == expected);
+
+      expected.clear();
+      std::set_difference(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                          std::back_inserter(expected));
+      c = lhs;
+      c.subtract(rhs);
+      REQUIRE(c.body() == expected);
+    }
+  }
+}
+
+template <typename T>
+void radix_sort_and_unique_test() {
+  std::mt19937_64 g;
+
+  for (size_t size : {size_t{0}, size_t{1}, size_t{255}, size_t{256},
+                      size_t{257}, size_t{1000}, size_t{5000}}) {
+    for (long long range : {0LL, 3LL, 300LL, -1LL}) {
+      std::uniform_int_distribution<long long> small(0, range);
+      std::vector<T> input(size);
+      std::generate(input.begin(), input.end(), [&] {
+        return static_cast<T>(range < 0 ? g() : small(g) - range / 2);
+      });
+
+      std::vector<T> expected = input;
+      std::sort(expected.begin(), expected.end());
+      expected.erase(std::unique(expected.begin(), expected.end()),
+                     expected.end());
+
+      input.erase(lib::sort_and_unique(input.begin(), input.end()),
+                  input.end());
+      REQUIRE(expected == input);
+    }
+  }
+}
+
+TEST_CASE("radix_sort_and_unique", "[sort_algorithms]") {
+  radix_sort_and_unique_test<char>();
+  radix_sort_and_unique_test<std::int8_t>();
+  radix_sort_and_unique_test<std::uint8_t>();
+  radix_sort_and_unique_test<std::int16_t>();
+  radix_sort_and_unique_test<std::uint16_t>();
+  radix_sort_and_unique_test<std::int32_t>();
+  radix_sort_and_unique_test<std::uint32_t>();
+  radix_sort_and_unique_test<std::int64_t>();
+  radix_sort_and_unique_test<std::uint64_t>();
+}
+
+TEST_CASE("sort_and_unique_adaptive", "[sort_algorithms]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 2000);
+  auto rand_int = [&] { return dis(g); };
+
+  auto test = [](std::vector<std::string> input) {
+    std::vector<std::string> expected = input;
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()),
+                   expected.end());
+
+    input.erase(lib::sort_and_unique(input.begin(), input.end()), input.end());
+    REQUIRE(expected == input);
+  };
+
+  auto as_strings = [](const int_vec& v) {
+    std::vector<std::string> res;
+    for (int x : v)
+      res.push_back(std::to_string(x));
+    return res;
+  };
+
+  auto sorted_run = [&](size_t size) {
+    int_vec res(size);
+    std::generate(res.begin(), res.end(), rand_int);
+    std::sort(res.begin(), res.end());
+    return res;
+  };
+
+  test({});
+  for (size_t runs : {1, 2, 3, 7}) {
+    for (size_t run_size : {1, 63, 64, 65, 300}) {
+      for (size_t tail_size : {0, 1, 10, 100}) {
+        int_vec input;
+        for (size_t i = 0; i < runs; ++i) {
+          int_vec run = sorted_run(run_size);
+          input.insert(input.end(), run.begin(), run.end());
+        }
+        std::generate_n(std::back_inserter(input), tail_size, rand_int);
+
+        int_vec ints = input;
+        ints.erase(lib::sort_and_unique(ints.begin(), ints.end()), ints.end());
+        REQUIRE(std::is_sorted(ints.begin(), ints.end()));
+        REQUIRE(std::adjacent_find(ints.begin(), ints.end()) == ints.end());
+
+        test(as_strings(input));
+        std::reverse(input.begin(), input.end());
+        test(as_strings(input));
+      }
+    }
+  }
+
+  // Two runs.
+  move_only_set::underlying_type move_only;
+  for (int i = 0; i < 200; ++i)
+    move_only.emplace_back(i % 150);
+  move_only_set c(std::move(move_only));
+  REQUIRE(c.size() == 150u);
+}
+
+TEST_CASE("merge_sort_and_unique", "[sort_algorithms]") {
+  std::mt19937 g;
+
+  for (size_t size : {0, 1, 31, 32, 33, 100, 1000}) {
+    for (int max : {0, 10, 1000, 1 << 30}) {
+      std::uniform_int_distribution<> dis(0, max);
+      std::vector<std::string> input(size);
+      std::generate(input.begin(), input.end(),
+                    [&] { return std::to_string(dis(g)); });
+
+      std::vector<std::string> expected = input;
+      std::sort(expected.begin(), expected.end());
+      expected.erase(std::unique(expected.begin(), expected.end()),
+                     expected.end());
+
+      input.erase(lib::merge_sort_and_unique(input.begin(), input.end()),
+                  input.end());
+      REQUIRE(expected == input);
+    }
+  }
+}
+
+TEST_CASE("sort_and_unique_parallel", "[sort_algorithms]") {
+  std::mt19937 g;
+  const size_t big = lib::kParallelSortThreshold * 3 + 17;
+
+  auto test = [](std::vector<std::string> input) {
+    std::vector<std::string> expected = input;
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()),
+                   expected.end());
+
+    for (size_t threads : {1, 2, 3, 4, 7, 16}) {
+      std::vector<std::string> actual = input;
+      actual.erase(lib::sort_and_unique_parallel(actual.begin(), actual.end(),
+                                                 lib::less{}, threads),
+                   actual.end());
+      REQUIRE(expected == actual);
+    }
+  };
+
+  for (int max : {10, 1000, 1 << 30}) {
+    std::uniform_int_distribution<> dis(0, max);
+    std::vector<std::string> input(big);
+    std::generate(input.begin(), input.end(),
+                  [&] { return std::to_string(dis(g)); });
+    test(input);
+  }
+
+  std::vector<std::string> sorted(big);
+  for (size_t i = 0; i < big; ++i)
+    sorted[i] = std::to_string(i + big);
+  test(sorted);
+  test({sorted.rbegin(), sorted.rend()});
+
+  const int big_int = static_cast<int>(big);
+  std::uniform_int_distribution<> dis(0, big_int - 1);
+  int_vec input(big);
+  std::generate(input.begin(), input.end(), [&] { return dis(g); });
+  std::set<int> expected(input.begin(), input.end());
+
+  int_set c(lib::parallel_t(4), input.begin(), input.end());
+  REQUIRE(std::equal(c.begin(), c.end(), expected.begin(), expected.end()));
+
+  int_set inserted{1, big_int};
+  inserted.insert(lib::parallel_t(4), input.begin(), input.end());
+  expected.insert({1, big_int});
+  REQUIRE(std::equal(inserted.begin(), inserted.end(), expected.begin(),
+                     expected.end()));
+}
+
 TEST_CASE("set_types", "[flat_cainers, flat_set]") {
   // These are guaranteed to be portable.
   static_assert((std::is_same<int, int_set::key_type>::value), "");
@@ -191,6 +626,29 @@ TEST_CASE("range_constructor", "[flat_cainers, flat_set]") {
   }
 }
 
+TEST_CASE("sorted_unique_constructor", "[flat_cainers, flat_set]") {
+  const int_vec expected = {1, 2, 3};
+  {
+    const int_set c(lib::sorted_unique, {1, 2, 3});
+    REQUIRE(expected == c.body());
+  }
+  {
+    const int_set c(lib::sorted_unique, expected.begin(), expected.end());
+    REQUIRE(expected == c.body());
+  }
+  {
+    int_vec input = expected;
+    const int* data = input.data();
+    const int_set c(lib::sorted_unique, std::move(input));
+    REQUIRE(expected == c.body());
+    REQUIRE(data == c.body().data());
+  }
+  {
+    const lib::flat_set<int, std::greater<>> c(lib::sorted_unique, {3, 2, 1});
+    REQUIRE(int_vec({3, 2, 1}) == c.body());
+  }
+}
+
 TEST_CASE("copy_constructor", "[flat_cainers, flat_set]") {
   const int_set original{1, 2, 3, 4};
   auto copy(original);
@@ -358,6 +816,73 @@ TEST_CASE("insert_emplace_v", "[flat_cainers, flat_set]") {
   }
 }
 
+template <typename C, typename V, typename = void>
+struct can_insert : std::false_type {};
+
+template <typename C, typename V>
+struct can_insert<
+    C,
+    V,
+    lib::detail::void_t<decltype(std::declval<C&>().insert(std::declval<V>()))>>
+    : std::true_type {};
+
+struct named_value {
+  static int constructed;
+
+  named_value(const char* name, int payload = 0)
+      : name(name), payload(payload) {
+    ++constructed;
+  }
+
+  friend bool operator<(const named_value& x, const named_value& y) {
+    return x.name < y.name;
+  }
+  friend bool operator<(const named_value& x, const char* y) {
+    return x.name < y;
+  }
+  friend bool operator<(const char* x, const named_value& y) {
+    return x < y.name;
+  }
+
+  std::string name;
+  int payload;
+};
+
+int named_value::constructed = 0;
+
+TEST_CASE("heterogeneous_insert", "[flat_cainers, flat_set]") {
+  lib::flat_set<named_value> c;
+  named_value::constructed = 0;
+
+  auto res = c.insert("b");
+  REQUIRE(res.second);
+  REQUIRE(named_value::constructed == 1);
+  REQUIRE(res.first->name == "b");
+
+  res = c.insert("b");
+  REQUIRE(!res.second);
+  REQUIRE(named_value::constructed == 1);
+
+  res = c.try_emplace("a", 5);
+  REQUIRE(res.second);
+  REQUIRE(res.first == c.begin());
+  REQUIRE(res.first->payload == 5);
+  REQUIRE(named_value::constructed == 2);
+
+  res = c.try_emplace("a", 7);
+  REQUIRE(!res.second);
+  REQUIRE(res.first->payload == 5);
+  REQUIRE(named_value::constructed == 2);
+
+  c.insert("c");
+  REQUIRE(c.size() == 3u);
+  REQUIRE(std::is_sorted(c.begin(), c.end()));
+
+  // Arithmetic types are inserted only as themselves.
+  static_assert(!can_insert<int_set, double>::value, "");
+  static_assert(can_insert<int_set, int>::value, "");
+}
+
 TEST_CASE("insert_emplace_hint_v", "[flat_cainers, flat_set]") {
   std::mt19937 g;
   std::uniform_int_distribution<> dis(1, 1000);
@@ -388,6 +913,48 @@ TEST_CASE("insert_emplace_hint_v", "[flat_cainers, flat_set]") {
   }
 }
 
+TEST_CASE("lower_bound_hinted", "[search_algorithms]") {
+  for (size_t size = 0; size < 40; ++size) {
+    int_vec v(size);
+    std::iota(v.begin(), v.end(), 0);
+    std::transform(v.begin(), v.end(), v.begin(), [](int x) { return 2 * x; });
+
+    for (int looking_for = -1; looking_for < static_cast<int>(2 * size + 1);
+         ++looking_for) {
+      auto expected = std::lower_bound(v.begin(), v.end(), looking_for);
+      for (auto hint = v.begin();; ++hint) {
+        REQUIRE(expected == lib::lower_bound_hinted(v.begin(), hint, v.end(),
+                                                    looking_for, lib::less{}));
+        if (hint == v.end())
+          break;
+      }
+    }
+  }
+}
+
+TEST_CASE("insert_hint_end_is_push_back", "[flat_cainers, flat_set]") {
+  size_t comparisons = 0;
+  auto counting_less = [&](int x, int y) {
+    ++comparisons;
+    return x < y;
+  };
+  lib::flat_set<int, decltype(counting_less)> c(counting_less);
+
+  for (int i = 0; i < 1000; ++i) {
+    comparisons = 0;
+    c.insert(c.end(), i);
+    REQUIRE(comparisons <= 2u);
+  }
+
+  // Exact hint in the middle.
+  c.erase(500);
+  comparisons = 0;
+  c.insert(c.begin() + 500, 500);
+  REQUIRE(comparisons <= 3u);
+  REQUIRE(c.size() == 1000u);
+  REQUIRE(std::is_sorted(c.begin(), c.end()));
+}
+
 TEST_CASE("insert_f_l", "[flat_cainers, flat_set]") {
   std::mt19937 g;
   std::uniform_int_distribution<> dis(1, 1000);
@@ -414,6 +981,161 @@ TEST_CASE("insert_f_l", "[flat_cainers, flat_set]") {
   }
 }
 
+TEST_CASE("insert_in_place_f_l", "[flat_cainers, flat_set]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(1, 1000);
+  auto rand_int = [&] { return dis(g); };
+
+  for (size_t c_size = 0; c_size < 100; ++c_size) {
+    for (size_t range_size = 0; range_size < 100; ++range_size) {
+      int_vec already_in(c_size);
+      std::generate(already_in.begin(), already_in.end(), rand_int);
+
+      int_vec new_elements(range_size);
+      std::generate(new_elements.begin(), new_elements.end(), rand_int);
+
+      int_set actual(already_in);
+      const size_t capacity = std::max(
+          actual.size() + new_elements.size(),
+          actual.size() + actual.size() / lib::detail::kInPlaceGrowthDivisor);
+      actual.insert_in_place(new_elements.begin(), new_elements.end());
+
+      int_vec expected = already_in;
+      expected.insert(expected.end(), new_elements.begin(), new_elements.end());
+      expected.erase(lib::sort_and_unique(expected.begin(), expected.end()),
+                     expected.end());
+
+      REQUIRE(expected == actual.body());
+      REQUIRE(actual.capacity() <= std::max(capacity, c_size));
+    }
+  }
+
+  // Big batches get exactly the space they need.
+  {
+    int_vec evens(1000);
+    for (size_t i = 0; i != evens.size(); ++i)
+      evens[i] = static_cast<int>(2 * i);
+    int_vec odds(evens.size());
+    for (size_t i = 0; i != odds.size(); ++i)
+      odds[i] = static_cast<int>(2 * i + 1);
+
+    for (size_t batch : {125u, 500u, 1000u}) {
+      int_set c(lib::sorted_unique, evens);
+      c.shrink_to_fit();
+      REQUIRE(c.capacity() == 1000u);
+      c.insert_in_place(odds.begin(), odds.begin() + batch);
+      REQUIRE(c.size() == 1000u + batch);
+      REQUIRE(c.capacity() == 1000u + batch);
+    }
+  }
+
+  // Small batches reallocate a logarithmic number of times.
+  int_set c;
+  size_t reallocations = 0;
+  for (int i = 0; i < 10000; ++i) {
+    const int* data = c.body().data();
+    int batch[] = {2 * i, 2 * i + 1};
+    c.insert_in_place(std::begin(batch), std::end(batch));
+    reallocations += data != c.body().data();
+  }
+  REQUIRE(c.size() == 20000u);
+  REQUIRE(reallocations < 100u);
+}
+
+TEST_CASE("insert_sorted_unique_f_l", "[flat_cainers, flat_set]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(1, 1000);
+  auto rand_int = [&] { return dis(g); };
+
+  for (size_t c_size = 0; c_size < 100; c_size += 3) {
+    for (size_t range_size = 0; range_size < 100; range_size += 3) {
+      int_vec already_in(c_size);
+      std::generate(already_in.begin(), already_in.end(), rand_int);
+
+      int_vec new_elements(range_size);
+      std::generate(new_elements.begin(), new_elements.end(), rand_int);
+      new_elements.erase(
+          lib::sort_and_unique(new_elements.begin(), new_elements.end()),
+          new_elements.end());
+
+      int_vec expected = already_in;
+      expected.insert(expected.end(), new_elements.begin(), new_elements.end());
+      expected.erase(lib::sort_and_unique(expected.begin(), expected.end()),
+                     expected.end());
+
+      int_set actual(already_in);
+      actual.insert(lib::sorted_unique, new_elements.begin(),
+                    new_elements.end());
+      REQUIRE(expected == actual.body());
+
+      // Input iterators.
+      std::stringstream stream;
+      for (int x : new_elements)
+        stream << x << ' ';
+      int_set from_stream(already_in);
+      from_stream.insert(lib::sorted_unique,
+                         std::istream_iterator<int>(stream),
+                         std::istream_iterator<int>());
+      REQUIRE(expected == from_stream.body());
+    }
+  }
+}
+
+TEST_CASE("merge", "[flat_cainers, flat_set]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(1, 1000);
+  auto rand_int = [&] { return dis(g); };
+
+  auto random_set = [&](size_t size) {
+    int_vec res(size);
+    std::generate(res.begin(), res.end(), rand_int);
+    return int_set(std::move(res));
+  };
+
+  for (size_t lhs_size = 0; lhs_size < 100; lhs_size += 3) {
+    for (size_t rhs_size = 0; rhs_size < 100; rhs_size += 3) {
+      const int_set lhs = random_set(lhs_size);
+      const int_set rhs = random_set(rhs_size);
+
+      int_vec expected;
+      std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                     std::back_inserter(expected));
+
+      {
+        int_set c = lhs;
+        c.reserve(lhs.size() + rhs.size());
+        const int* data = c.body().data();
+        c.merge(rhs);
+        REQUIRE(expected == c.body());
+        REQUIRE(data == c.body().data());
+      }
+      {
+        int_set c = lhs;
+        int_set x = rhs;
+        x.reserve(lhs.size() + rhs.size());
+        const int* data = x.body().data();
+        c.merge(std::move(x));
+        REQUIRE(expected == c.body());
+        REQUIRE(x.empty());
+        if (!rhs.empty())
+          REQUIRE(data == c.body().data());
+      }
+      {
+        int_set c = lhs;
+        int_set x = rhs;
+        c.merge(std::move(x));
+        REQUIRE(expected == c.body());
+      }
+    }
+  }
+
+  int_set c{1, 2, 3};
+  c.merge(c);
+  REQUIRE(c == int_set{1, 2, 3});
+  c.merge(std::move(c));
+  REQUIRE(c == int_set{1, 2, 3});
+}
+
 TEST_CASE("erase_pos", "[flat_cainers, flat_set]") {
   {
     int_set c{1, 2, 3, 4, 5, 6, 7, 8};
@@ -851,3 +1573,899 @@ TEST_CASE("erase_if", "[flat_cainers, flat_set]") {
   expected = {2, 4};
   REQUIRE(expected == x.body());
 }
+
+namespace {
+
+using int_map = lib::flat_map<int, int>;
+using int_pair_vec = std::vector<std::pair<int, int>>;
+
+int_pair_vec as_pairs(const int_map& m) {
+  int_pair_vec res;
+  for (auto it = m.begin(); it != m.end(); ++it)
+    res.emplace_back((*it).first, (*it).second);
+  return res;
+}
+
+}  // namespace
+
+TEST_CASE("map_range_constructor", "[flat_cainers, flat_map]") {
+  {
+    const int_map c{{3, 0}, {1, 1}, {3, 2}, {2, 3}, {1, 4}};
+    const int_vec expected_keys = {1, 2, 3};
+    const int_vec expected_values = {1, 3, 0};
+    REQUIRE(expected_keys == c.keys());
+    REQUIRE(expected_values == c.values());
+  }
+  {
+    const int_map c(int_vec{5, 4, 5, 1}, int_vec{0, 1, 2, 3});
+    const int_pair_vec expected = {{1, 3}, {4, 1}, {5, 0}};
+    REQUIRE(expected == as_pairs(c));
+  }
+}
+
+TEST_CASE("map_element_access", "[flat_cainers, flat_map]") {
+  int_map c{{1, 10}, {3, 30}};
+
+  REQUIRE(10 == c[1]);
+  c[2] = 20;
+  ++c[3];
+  const int_pair_vec expected = {{1, 10}, {2, 20}, {3, 31}};
+  REQUIRE(expected == as_pairs(c));
+
+  REQUIRE(20 == c.at(2));
+  REQUIRE_THROWS_AS(c.at(4), std::out_of_range);
+
+  auto it = c.find(3);
+  it->second = 5;
+  REQUIRE(5 == c.values().back());
+  REQUIRE(c.end() == c.find(0));
+  REQUIRE(1U == c.count(1));
+  REQUIRE(0U == c.count(4));
+}
+
+TEST_CASE("map_insert_v", "[flat_cainers, flat_map]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(1, 1000);
+
+  int_map c;
+  std::map<int, int> test;
+
+  for (int i = 0; i < 1000; ++i) {
+    int k = dis(g);
+
+    auto actual = c.insert({k, i});
+    auto expected = test.insert({k, i});
+    REQUIRE(expected.second == actual.second);
+    REQUIRE(std::distance(test.begin(), expected.first) ==
+            std::distance(c.begin(), actual.first));
+  }
+
+  REQUIRE(int_pair_vec(test.begin(), test.end()) == as_pairs(c));
+}
+
+TEST_CASE("map_insert_f_l", "[flat_cainers, flat_map]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(1, 1000);
+  auto rand_pair = [&] { return std::make_pair(dis(g), dis(g)); };
+
+  for (size_t c_size = 0; c_size < 100; c_size += 3) {
+    for (size_t range_size = 0; range_size < 100; range_size += 3) {
+      int_pair_vec already_in(c_size);
+      std::generate(already_in.begin(), already_in.end(), rand_pair);
+
+      int_pair_vec new_elements(range_size);
+      std::generate(new_elements.begin(), new_elements.end(), rand_pair);
+
+      int_map actual(already_in.begin(), already_in.end());
+      actual.insert(new_elements.begin(), new_elements.end());
+
+      std::map<int, int> expected(already_in.begin(), already_in.end());
+      expected.insert(new_elements.begin(), new_elements.end());
+
+      REQUIRE(int_pair_vec(expected.begin(), expected.end()) ==
+              as_pairs(actual));
+    }
+  }
+}
+
+TEST_CASE("map_erase", "[flat_cainers, flat_map]") {
+  int_map c{{1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5}};
+
+  REQUIRE(0U == c.erase(6));
+  REQUIRE(1U == c.erase(2));
+  auto it = c.erase(c.begin());
+  REQUIRE(c.begin() == it);
+  it = c.erase(std::next(c.cbegin()), c.cend());
+  REQUIRE(c.end() == it);
+  REQUIRE(int_pair_vec{{3, 3}} == as_pairs(c));
+
+  c = {{1, 1}, {2, 2}, {3, 3}, {4, 4}};
+  lib::erase_if(c, [](int_map::const_reference x) { return x.first & 1; });
+  const int_pair_vec expected = {{2, 2}, {4, 4}};
+  REQUIRE(expected == as_pairs(c));
+}
+
+TEST_CASE("map_iterators", "[flat_cainers, flat_map]") {
+  int_map c{{1, 1}, {2, 2}, {3, 3}};
+
+  int_map::const_iterator c_it = c.begin();
+  REQUIRE(c_it == c.cbegin());
+  REQUIRE(3 == std::distance(c.rbegin(), c.rend()));
+  REQUIRE(3 == (*c.rbegin()).first);
+  REQUIRE(2 == c.begin()[1].second);
+  REQUIRE(c.lower_bound(2) == c.begin() + 1);
+  REQUIRE(c.upper_bound(2) == c.begin() + 2);
+  REQUIRE(c.equal_range(4).first == c.end());
+}
+
+TEST_CASE("eytzinger_search", "[flat_cainers, eytzinger_set]") {
+  for (int size = 0; size < 100; ++size) {
+    int_vec sorted(static_cast<size_t>(size));
+    for (int i = 0; i < size; ++i)
+      sorted[i] = 2 * i;
+
+    const lib::eytzinger_set<int> c(sorted.rbegin(), sorted.rend());
+    REQUIRE(sorted.size() == c.size());
+    REQUIRE(sorted == int_vec(c.begin(), c.end()));
+    REQUIRE(int_vec(sorted.rbegin(), sorted.rend()) ==
+            int_vec(c.rbegin(), c.rend()));
+
+    for (int looking_for = -1; looking_for <= 2 * size; ++looking_for) {
+      auto expected_lb = std::lower_bound(sorted.begin(), sorted.end(),
+                                          looking_for) - sorted.begin();
+      auto expected_ub = std::upper_bound(sorted.begin(), sorted.end(),
+                                          looking_for) - sorted.begin();
+      REQUIRE(expected_lb ==
+              std::distance(c.begin(), c.lower_bound(looking_for)));
+      REQUIRE(expected_ub ==
+              std::distance(c.begin(), c.upper_bound(looking_for)));
+
+      auto eq_range = c.equal_range(looking_for);
+      REQUIRE(expected_lb == std::distance(c.begin(), eq_range.first));
+      REQUIRE(expected_ub == std::distance(c.begin(), eq_range.second));
+
+      bool is_found = !(looking_for & 1) && looking_for < 2 * size;
+      REQUIRE(is_found == (c.find(looking_for) != c.end()));
+      REQUIRE(static_cast<size_t>(is_found) == c.count(looking_for));
+    }
+  }
+}
+
+TEST_CASE("eytzinger_from_flat_set", "[flat_cainers, eytzinger_set]") {
+  const int_set s{5, 1, 4, 1, 3};
+  const lib::eytzinger_set<int> c(s);
+  REQUIRE(s.body() == int_vec(c.begin(), c.end()));
+  REQUIRE(c == lib::eytzinger_set<int>({1, 3, 4, 5}));
+  REQUIRE(c.end() == c.find(2));
+}
+
+namespace {
+
+template <typename T>
+void simd_lower_bound_test(T min_value) {
+  for (int size = 0; size < 150; ++size) {
+    std::vector<T> sorted(static_cast<size_t>(size));
+    for (int i = 0; i < size; ++i)
+      sorted[i] = min_value + static_cast<T>(3 * i);
+
+    const lib::flat_set<T> c(sorted.begin(), sorted.end());
+    for (int i = -1; i <= 3 * size; ++i) {
+      const T looking_for = min_value + static_cast<T>(i);
+      auto expected =
+          std::lower_bound(sorted.begin(), sorted.end(), looking_for);
+      auto actual = c.lower_bound(looking_for);
+      REQUIRE(std::distance(sorted.begin(), expected) ==
+              std::distance(c.begin(), actual));
+      bool is_found = expected != sorted.end() && *expected == looking_for;
+      REQUIRE(is_found == (c.find(looking_for) != c.end()));
+      REQUIRE(static_cast<size_t>(is_found) == c.count(looking_for));
+    }
+  }
+}
+
+}  // namespace
+
+TEST_CASE("simd_lower_bound", "[flat_cainers, flat_set]") {
+  simd_lower_bound_test<std::int32_t>(-200);
+  simd_lower_bound_test<std::int64_t>(-(std::int64_t(1) << 40));
+  simd_lower_bound_test<std::uint32_t>(std::uint32_t(1) << 31);
+  simd_lower_bound_test<std::uint32_t>(0);
+  simd_lower_bound_test<std::int16_t>(-100);
+  simd_lower_bound_test<double>(-0.5);
+
+  static_assert(lib::detail::use_simd_lower_bound<std::vector<int>::iterator,
+                                                  int, lib::less>::value,
+                "");
+  static_assert(!lib::detail::use_simd_lower_bound<
+                    std::vector<int>::iterator, double, lib::less>::value,
+                "");
+  static_assert(!lib::detail::use_simd_lower_bound<
+                    std::vector<int>::iterator, int, std::greater<>>::value,
+                "");
+}
+
+namespace {
+
+template <typename SearchPolicy>
+void search_policy_test() {
+  using set_t = lib::flat_set<int, lib::less, int_vec, SearchPolicy>;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(1, 300);
+
+  set_t c;
+  std::set<int> test;
+  for (int i = 0; i < 300; ++i) {
+    int v = dis(g);
+    REQUIRE(test.insert(v).second == c.insert(v).second);
+    REQUIRE(int_vec(test.begin(), test.end()) == c.body());
+
+    for (int looking_for = 0; looking_for <= 301; looking_for += 7) {
+      REQUIRE(std::distance(test.begin(), test.lower_bound(looking_for)) ==
+              std::distance(c.begin(), c.lower_bound(looking_for)));
+      REQUIRE(std::distance(test.begin(), test.upper_bound(looking_for)) ==
+              std::distance(c.begin(), c.upper_bound(looking_for)));
+      REQUIRE(test.count(looking_for) == c.count(looking_for));
+    }
+  }
+}
+
+}  // namespace
+
+TEST_CASE("search_policies", "[flat_cainers, flat_set]") {
+  search_policy_test<lib::binary_search_policy>();
+  search_policy_test<lib::linear_search_policy>();
+  search_policy_test<lib::biased_search_policy>();
+  search_policy_test<lib::branchless_search_policy>();
+}
+
+TEST_CASE("lower_bound_algorithms", "[search_algorithms]") {
+  int_vec v(100);
+  for (int i = 0; i < static_cast<int>(v.size()); ++i)
+    v[i] = i / 2;
+
+  for (auto l = v.begin(); l != v.end(); ++l) {
+    for (int looking_for = -1; looking_for <= 51; ++looking_for) {
+      auto expected = std::lower_bound(v.begin(), l, looking_for);
+      REQUIRE(expected == lib::lower_bound_linear(v.begin(), l, looking_for));
+      REQUIRE(expected == lib::lower_bound_biased(v.begin(), l, looking_for));
+      REQUIRE(expected ==
+              lib::lower_bound_branchless(v.begin(), l, looking_for));
+    }
+  }
+}
+
+TEST_CASE("finger_searcher", "[flat_cainers, flat_set]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 2000);
+  std::uniform_int_distribution<> step(0, 30);
+
+  int_vec input(500);
+  std::generate(input.begin(), input.end(), [&] { return dis(g); });
+  const int_set c(input.begin(), input.end());
+
+  auto searcher = c.searcher();
+  int looking_for = -5;
+  for (int i = 0; i < 1000; ++i) {
+    // Mostly forward, sometimes jumping back.
+    looking_for += (i % 50 == 49) ? -10 * step(g) : step(g);
+
+    REQUIRE(c.lower_bound(looking_for) == searcher.lower_bound(looking_for));
+    REQUIRE(c.find(looking_for) == searcher.find(looking_for));
+    REQUIRE(c.count(looking_for) == searcher.count(looking_for));
+  }
+
+  const int_set empty;
+  auto empty_searcher = empty.searcher();
+  REQUIRE(empty.end() == empty_searcher.lower_bound(1));
+  REQUIRE(empty.end() == empty_searcher.find(1));
+}
+
+TEST_CASE("batch_lookups", "[flat_cainers, flat_set]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 1000);
+  auto rand_int = [&] { return dis(g); };
+
+  for (size_t size = 0; size < 300; size += 7) {
+    int_vec input(size);
+    std::generate(input.begin(), input.end(), rand_int);
+    const int_set c(input.begin(), input.end());
+
+    for (size_t queries_size : {0, 1, 15, 16, 17, 100}) {
+      int_vec queries(queries_size);
+      std::generate(queries.begin(), queries.end(), rand_int);
+
+      std::vector<int_set::const_iterator> expected_lb, expected_find;
+      for (int q : queries) {
+        expected_lb.push_back(c.lower_bound(q));
+        expected_find.push_back(c.find(q));
+      }
+
+      std::vector<int_set::const_iterator> actual;
+      c.lower_bound_batch(queries.begin(), queries.end(),
+                          std::back_inserter(actual));
+      REQUIRE(expected_lb == actual);
+
+      actual.clear();
+      c.find_batch(queries.begin(), queries.end(), std::back_inserter(actual));
+      REQUIRE(expected_find == actual);
+    }
+  }
+}
+
+TEST_CASE("buffered_flat_set", "[flat_cainers, buffered_flat_set]") {
+  using buffered = lib::buffered_flat_set<int>;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 2000);
+
+  buffered c;
+  std::set<int> expected;
+  for (int i = 0; i < 5000; ++i) {
+    int x = dis(g);
+    REQUIRE(c.insert(x) == expected.insert(x).second);
+    REQUIRE(c.size() == expected.size());
+
+    int y = dis(g);
+    REQUIRE(c.count(y) == expected.count(y));
+
+    if (i % 3 == 0) {
+      int z = dis(g);
+      REQUIRE(c.erase(z) == expected.erase(z));
+    }
+
+    if (i % 1000 == 0)
+      REQUIRE(std::equal(c.begin(), c.end(), expected.begin(),
+                         expected.end()));
+  }
+  REQUIRE(std::equal(c.begin(), c.end(), expected.begin(), expected.end()));
+
+  // Erase from the buffer.
+  buffered small{1, 5, 9};
+  REQUIRE(small.insert(3));
+  REQUIRE(small.insert(7));
+  REQUIRE_FALSE(small.insert(3));
+  REQUIRE(small.erase(3) == 1u);
+  REQUIRE(small.erase(3) == 0u);
+  REQUIRE(small.count(7) == 1u);
+  REQUIRE(small == buffered({1, 5, 7, 9}));
+  // Iterating a const set does not merge the buffer.
+  const buffered& const_small = small;
+  REQUIRE(int_vec(const_small.begin(), const_small.end()) ==
+          int_vec({1, 5, 7, 9}));
+  REQUIRE(small.sorted().body() == int_vec({1, 5, 7, 9}));
+
+  small.clear();
+  REQUIRE(small.empty());
+  REQUIRE(small.begin() == small.end());
+}
+
+TEST_CASE("buffered_flat_set_heterogeneous",
+          "[flat_cainers, buffered_flat_set]") {
+  lib::buffered_flat_set<std::string> c;
+  REQUIRE(c.insert("abc"));
+  REQUIRE(c.emplace(3u, 'a'));
+  REQUIRE_FALSE(c.insert(std::string("aaa")));
+  REQUIRE(c.contains("abc"));
+  REQUIRE_FALSE(c.contains("ab"));
+  c.flush();
+  REQUIRE(c.contains("abc"));
+  REQUIRE(std::vector<std::string>(c.begin(), c.end()) ==
+          std::vector<std::string>({"aaa", "abc"}));
+}
+
+TEST_CASE("leveled_flat_set", "[flat_cainers, leveled_flat_set]") {
+  using leveled = lib::leveled_flat_set<int>;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 20000);
+
+  leveled c;
+  std::set<int> expected;
+  for (int i = 0; i < 50000; ++i) {
+    int x = dis(g);
+    REQUIRE(c.insert(x) == expected.insert(x).second);
+
+    int y = dis(g);
+    REQUIRE(c.count(y) == expected.count(y));
+
+    if (i % 2 == 0) {
+      int z = dis(g);
+      REQUIRE(c.erase(z) == expected.erase(z));
+    }
+    REQUIRE(c.size() == expected.size());
+
+    if (i % 10000 == 0)
+      REQUIRE(std::equal(c.begin(), c.end(), expected.begin(),
+                         expected.end()));
+  }
+  REQUIRE(std::equal(c.begin(), c.end(), expected.begin(), expected.end()));
+  REQUIRE(c.level_count() > 1u);
+  c.compact();
+  REQUIRE(std::equal(c.begin(), c.end(), expected.begin(), expected.end()));
+  REQUIRE(c.level_count() == 1u);
+  REQUIRE(c.insert(-1));
+  REQUIRE(c.level_count() == 2u);
+  REQUIRE(c.erase(-1) == 1u);
+  REQUIRE(c.count(-1) == 0u);
+
+  // Tombstones hide older levels.
+  leveled from_range(expected.begin(), expected.end());
+  REQUIRE(from_range == c);
+  for (int x : expected)
+    REQUIRE(from_range.erase(x) == 1u);
+  REQUIRE(from_range.empty());
+  REQUIRE(from_range.count(*expected.begin()) == 0u);
+  REQUIRE(from_range.begin() == from_range.end());
+
+  leveled small{3, 1, 2};
+  REQUIRE(small.erase(2) == 1u);
+  REQUIRE(small.insert(2));
+  REQUIRE_FALSE(small.insert(2));
+  REQUIRE(small == leveled({1, 2, 3}));
+
+  small.clear();
+  REQUIRE(small.empty());
+  REQUIRE(small.begin() == small.end());
+}
+
+TEST_CASE("leveled_flat_set_heterogeneous",
+          "[flat_cainers, leveled_flat_set]") {
+  lib::leveled_flat_set<std::string> c;
+  REQUIRE(c.insert("abc"));
+  REQUIRE(c.emplace(3u, 'a'));
+  REQUIRE_FALSE(c.insert(std::string("aaa")));
+  REQUIRE(c.contains("abc"));
+  REQUIRE(c.erase("abc") == 1u);
+  REQUIRE_FALSE(c.contains("abc"));
+  REQUIRE(std::vector<std::string>(c.begin(), c.end()) ==
+          std::vector<std::string>({"aaa"}));
+}
+
+// Counts conversions from int.
+struct counted_int {
+  static size_t conversions;
+
+  counted_int(int body) : body(body) { ++conversions; }
+
+  friend bool operator<(const counted_int& x, const counted_int& y) {
+    return x.body < y.body;
+  }
+
+  int body;
+};
+
+size_t counted_int::conversions = 0;
+
+TEST_CASE("leveled_flat_set_non_transparent",
+          "[flat_cainers, leveled_flat_set]") {
+  lib::leveled_flat_set<counted_int, std::less<counted_int>> c;
+  for (int i = 0; i < 1000; ++i)
+    c.insert(counted_int(2 * i));
+  REQUIRE(c.level_count() > 1u);
+
+  // The key is converted once for the search, not on every comparison.
+  counted_int::conversions = 0;
+  REQUIRE_FALSE(c.insert(500));
+  REQUIRE(counted_int::conversions == 1u);
+
+  counted_int::conversions = 0;
+  REQUIRE(c.insert(501));
+  REQUIRE(counted_int::conversions == 2u);
+
+  counted_int::conversions = 0;
+  REQUIRE(c.erase(500) == 1u);
+  REQUIRE(c.erase(503) == 0u);
+  REQUIRE(counted_int::conversions == 2u);
+
+  REQUIRE(c.contains(501));
+  REQUIRE_FALSE(c.contains(500));
+  REQUIRE(c.size() == 1000u);
+}
+
+TEST_CASE("segmented_flat_set", "[flat_cainers, segmented_flat_set]") {
+  using segmented = lib::segmented_flat_set<int>;
+  static_assert(segmented::kChunkSize == 1024, "");
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 20000);
+
+  segmented c;
+  std::set<int> expected;
+  for (int i = 0; i < 40000; ++i) {
+    int x = dis(g);
+    auto inserted = c.insert(x);
+    REQUIRE(inserted.second == expected.insert(x).second);
+    REQUIRE(*inserted.first == x);
+
+    int y = dis(g);
+    REQUIRE(c.count(y) == expected.count(y));
+    auto lb = c.lower_bound(y);
+    auto expected_lb = expected.lower_bound(y);
+    REQUIRE((lb == c.end()) == (expected_lb == expected.end()));
+    if (lb != c.end())
+      REQUIRE(*lb == *expected_lb);
+
+    if (i % 3 == 0) {
+      int z = dis(g);
+      REQUIRE(c.erase(z) == expected.erase(z));
+    }
+    REQUIRE(c.size() == expected.size());
+
+    if (i % 5000 == 0) {
+      REQUIRE(std::equal(c.begin(), c.end(), expected.begin(),
+                         expected.end()));
+      REQUIRE(std::equal(c.rbegin(), c.rend(), expected.rbegin(),
+                         expected.rend()));
+    }
+  }
+  REQUIRE(c.chunk_count() > 1u);
+
+  // Erase everything through iterators.
+  auto it = c.begin();
+  while (it != c.end()) {
+    REQUIRE(*it == *expected.begin());
+    expected.erase(expected.begin());
+    it = c.erase(it);
+  }
+  REQUIRE(c.empty());
+  REQUIRE(c.chunk_count() == 0u);
+}
+
+TEST_CASE("segmented_flat_set_insert_f_l",
+          "[flat_cainers, segmented_flat_set]") {
+  using segmented = lib::segmented_flat_set<int>;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 100000);
+
+  segmented c;
+  std::set<int> expected;
+  for (size_t batch : {0, 1, 10, 3000, 10, 20000, 500}) {
+    int_vec input(batch);
+    std::generate(input.begin(), input.end(), [&] { return dis(g); });
+    c.insert(input.begin(), input.end());
+    expected.insert(input.begin(), input.end());
+    REQUIRE(c.size() == expected.size());
+    REQUIRE(std::equal(c.begin(), c.end(), expected.begin(), expected.end()));
+    for (int x : input)
+      REQUIRE(c.count(x) == 1u);
+  }
+
+  REQUIRE(segmented({3, 1, 2, 3}) == segmented({1, 2, 3}));
+  REQUIRE(*segmented({3, 1, 2}).upper_bound(2) == 3);
+
+  lib::segmented_flat_set<std::string> strings{"b", "a"};
+  REQUIRE(strings.count("a") == 1u);
+  REQUIRE(strings.find("c") == strings.end());
+  REQUIRE(*strings.upper_bound("a") == "b");
+}
+
+TEST_CASE("segmented_flat_set_bulk_erase",
+          "[flat_cainers, segmented_flat_set]") {
+  using segmented = lib::segmented_flat_set<int>;
+  constexpr int kStep = 768;
+  constexpr int kSize = 1000 * kStep;
+
+  int_vec all(kSize);
+  std::iota(all.begin(), all.end(), 0);
+  int_vec kept;
+  for (int x = 0; x < kSize; x += kStep)
+    kept.push_back(x);
+
+  auto small_enough = [](const segmented& c) {
+    return c.chunk_count() <= c.size() / segmented::kMinChunkSize + 1;
+  };
+
+  // Left to right.
+  {
+    segmented c(all.begin(), all.end());
+    for (int x = 0; x < kSize; ++x) {
+      if (x % kStep)
+        REQUIRE(c.erase(x) == 1u);
+    }
+    REQUIRE(int_vec(c.begin(), c.end()) == kept);
+    REQUIRE(small_enough(c));
+  }
+  // Right to left.
+  {
+    segmented c(all.begin(), all.end());
+    for (int x = kSize - 1; x >= 0; --x) {
+      if (x % kStep)
+        REQUIRE(c.erase(x) == 1u);
+    }
+    REQUIRE(int_vec(c.begin(), c.end()) == kept);
+    REQUIRE(small_enough(c));
+  }
+  // By iterator: the returned iterator points to the next element.
+  {
+    segmented c(all.begin(), all.end());
+    for (auto it = c.begin(); it != c.end();) {
+      if (*it % kStep) {
+        int next = *it + 1;
+        it = c.erase(it);
+        if (it != c.end())
+          REQUIRE(*it == next);
+      } else {
+        ++it;
+      }
+    }
+    REQUIRE(int_vec(c.begin(), c.end()) == kept);
+    REQUIRE(small_enough(c));
+  }
+}
+
+TEST_CASE("cow_flat_set", "[flat_cainers, cow_flat_set]") {
+  using cow = lib::cow_flat_set<int>;
+
+  cow empty;
+  REQUIRE(empty.empty());
+  REQUIRE(empty.begin() == empty.end());
+  REQUIRE(empty.find(1) == empty.end());
+  REQUIRE_FALSE(empty.is_shared());
+
+  cow c{3, 1, 2};
+  cow copy = c;
+  REQUIRE(c.is_shared());
+  REQUIRE(copy.is_shared());
+  REQUIRE(c.body().data() == copy.body().data());
+  REQUIRE(c == copy);
+
+  // Reads and erasing what is not there do not detach.
+  REQUIRE(copy.count(2) == 1u);
+  REQUIRE(*copy.lower_bound(2) == 2);
+  REQUIRE(copy.erase(10) == 0u);
+  REQUIRE(copy.is_shared());
+
+  REQUIRE(copy.insert(4).second);
+  REQUIRE_FALSE(copy.is_shared());
+  REQUIRE_FALSE(c.is_shared());
+  REQUIRE(c.body() == int_vec({1, 2, 3}));
+  REQUIRE(copy.body() == int_vec({1, 2, 3, 4}));
+
+  // unshare is a no-op for an unshared set.
+  const auto* data = copy.body().data();
+  copy.unshare();
+  REQUIRE(copy.body().data() == data);
+
+  cow copy2 = copy;
+  copy2.unshare();
+  REQUIRE(copy2.body().data() != data);
+  REQUIRE(copy2 == copy);
+
+  copy2.erase(copy2.begin());
+  REQUIRE(copy2.body() == int_vec({2, 3, 4}));
+  REQUIRE(copy2.erase(3) == 1u);
+  REQUIRE(copy.body() == int_vec({1, 2, 3, 4}));
+
+  cow moved = std::move(copy2);
+  REQUIRE(moved.body() == int_vec({2, 4}));
+
+  cow shared_clear = moved;
+  shared_clear.clear();
+  REQUIRE(shared_clear.empty());
+  REQUIRE(moved.body() == int_vec({2, 4}));
+  REQUIRE(shared_clear.emplace(5).second);
+  REQUIRE(shared_clear.body() == int_vec({5}));
+  REQUIRE(std::vector<int>(moved.rbegin(), moved.rend()) == int_vec({4, 2}));
+}
+
+TEST_CASE("cow_flat_set_threads", "[flat_cainers, cow_flat_set]") {
+  using cow = lib::cow_flat_set<int>;
+
+  // Every thread reads its copy and then changes it, which detaches it or,
+  // for the last owner, changes the shared set in place.
+  const cow original{1, 2, 3};
+  for (int round = 0; round < 20; ++round) {
+    std::vector<cow> copies(4, original);
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&copies, &failures, i] {
+        cow& c = copies[static_cast<size_t>(i)];
+        if (c.body() != int_vec({1, 2, 3}))
+          ++failures;
+        c.insert(10 + i);
+        if (c.size() != 4u || !c.count(10 + i))
+          ++failures;
+      });
+    }
+    for (auto& t : threads)
+      t.join();
+    REQUIRE(failures.load() == 0);
+    REQUIRE(original.body() == int_vec({1, 2, 3}));
+  }
+}
+
+TEST_CASE("rcu_flat_set", "[flat_cainers, rcu_flat_set]") {
+  lib::rcu_flat_set<int> c(int_set{1, 2, 3});
+
+  auto before = c.read();
+  c.insert(5);
+  c.erase(1);
+  c.insert(7);
+  c.erase(7);
+  c.erase(4);
+  c.insert(2);
+  REQUIRE(c.count(5) == 0u);
+  c.publish();
+
+  REQUIRE(before->body() == int_vec({1, 2, 3}));
+  REQUIRE(c.read()->body() == int_vec({2, 3, 5}));
+  REQUIRE(c.size() == 3u);
+  REQUIRE(c.retired_versions() == 1u);
+
+  {
+    auto moved = std::move(before);
+    REQUIRE(moved->size() == 3u);
+  }
+  REQUIRE(c.retired_versions() == 0u);
+}
+
+TEST_CASE("rcu_flat_set_more_readers_than_slots",
+          "[flat_cainers, rcu_flat_set]") {
+  using set_t = lib::rcu_flat_set<int>;
+  set_t c(int_set{1});
+
+  std::vector<set_t::snapshot> snapshots;
+  for (size_t i = 0; i != set_t::kReaderSlots + 2; ++i)
+    snapshots.push_back(c.read());
+
+  c.insert(2);
+  c.publish();
+  auto last = c.read();
+  c.insert(3);
+  c.publish();
+
+  // Readers without a slot hold every version.
+  REQUIRE(c.retired_versions() == 2u);
+  REQUIRE(snapshots.front()->body() == int_vec({1}));
+  REQUIRE(snapshots.back()->body() == int_vec({1}));
+  REQUIRE(last->body() == int_vec({1, 2}));
+
+  // last has no slot either.
+  snapshots.clear();
+  REQUIRE(c.retired_versions() == 2u);
+  {
+    auto moved = std::move(last);
+  }
+  REQUIRE(c.retired_versions() == 0u);
+}
+
+TEST_CASE("rcu_flat_set_threads", "[flat_cainers, rcu_flat_set]") {
+  // Every version is {0, ..., n - 1} for some n.
+  lib::rcu_flat_set<int> c;
+  std::atomic<bool> done{false};
+
+  std::vector<std::thread> readers;
+  std::atomic<int> failures{0};
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!done.load()) {
+        auto s = c.read();
+        const int n = static_cast<int>(s->size());
+        if (n && (s->body().front() != 0 || s->body().back() != n - 1))
+          ++failures;
+      }
+    });
+  }
+
+  for (int n = 0; n < 300; ++n) {
+    c.insert(n);
+    c.publish();
+  }
+  done = true;
+  for (auto& t : readers)
+    t.join();
+
+  REQUIRE(failures.load() == 0);
+  REQUIRE(c.size() == 300u);
+  REQUIRE(c.retired_versions() == 0u);
+}
+
+TEST_CASE("sharded_flat_set", "[flat_cainers, sharded_flat_set]") {
+  lib::sharded_flat_set<int> c(4);
+  REQUIRE(c.empty());
+  REQUIRE(c.shard_count() == 4u);
+
+  REQUIRE(c.insert(3));
+  REQUIRE(c.insert(1));
+  REQUIRE_FALSE(c.insert(3));
+  REQUIRE(c.count(1) == 1u);
+  REQUIRE(c.count(2) == 0u);
+  REQUIRE(c.erase(1) == 1u);
+  REQUIRE(c.erase(1) == 0u);
+  REQUIRE(c.to_flat_set() == lib::flat_set<int>{3});
+
+  // Enough elements to rebalance several times.
+  std::vector<int> expected;
+  for (int i = 0; i < 10000; ++i) {
+    c.insert(i * 7 % 10000);
+    expected.push_back(i);
+  }
+  REQUIRE(c.size() == 10000u);
+  REQUIRE(c.to_flat_set().body() == expected);
+
+  auto sizes = c.shard_sizes();
+  REQUIRE(sizes.size() == 4u);
+  for (auto size : sizes)
+    REQUIRE(size >= 1000u);
+
+  int prev = -1;
+  bool sorted = true;
+  c.for_each([&](int x) {
+    sorted = sorted && prev < x;
+    prev = x;
+  });
+  REQUIRE(sorted);
+
+  c.clear();
+  REQUIRE(c.empty());
+  c.insert(5);
+  REQUIRE(c.to_flat_set() == lib::flat_set<int>{5});
+}
+
+TEST_CASE("sharded_flat_set_insert_f_l", "[flat_cainers, sharded_flat_set]") {
+  lib::sharded_flat_set<int> c(8);
+  lib::flat_set<int> expected;
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 1 << 20);
+  // The last batch is big enough to be merged on several threads.
+  for (size_t batch_size : {10u, 1000u, 5000u, 100000u}) {
+    std::vector<int> batch(batch_size);
+    for (int& x : batch)
+      x = dis(g);
+    c.insert(batch.begin(), batch.end());
+    expected.insert(batch.begin(), batch.end());
+    REQUIRE(c.to_flat_set() == expected);
+
+    for (int& x : batch)
+      x = dis(g);
+    c.insert(lib::parallel_t(4), batch.begin(), batch.end());
+    expected.insert(batch.begin(), batch.end());
+    REQUIRE(c.to_flat_set() == expected);
+  }
+
+  std::vector<int> empty;
+  c.insert(empty.begin(), empty.end());
+  REQUIRE(c.size() == expected.size());
+}
+
+TEST_CASE("sharded_flat_set_threads", "[flat_cainers, sharded_flat_set]") {
+  lib::sharded_flat_set<int> c;
+
+  // Every writer inserts its own residue class, half one by one and half in
+  // batches, then erases a part of it.
+  constexpr int kWriters = 4;
+  constexpr int kPerWriter = 5000;
+  std::vector<std::thread> writers;
+  for (int w = 0; w < kWriters; ++w) {
+    writers.emplace_back([&c, w] {
+      std::vector<int> batch;
+      for (int i = 0; i < kPerWriter; ++i) {
+        int x = i * kWriters + w;
+        if (i % 2)
+          c.insert(x);
+        else
+          batch.push_back(x);
+        if (batch.size() == 100) {
+          c.insert(batch.begin(), batch.end());
+          batch.clear();
+        }
+      }
+      c.insert(batch.begin(), batch.end());
+      for (int i = 0; i < kPerWriter; i += 10)
+        c.erase(i * kWriters + w);
+    });
+  }
+  for (auto& t : writers)
+    t.join();
+
+  std::vector<int> expected;
+  for (int x = 0; x < kWriters * kPerWriter; ++x) {
+    if ((x / kWriters) % 10)
+      expected.push_back(x);
+  }
+  REQUIRE(c.to_flat_set().body() == expected);
+}
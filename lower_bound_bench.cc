@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <numeric>
+#include <random>
+#include <vector>
 
+#include "eytzinger_set.h"
 #include "lib.h"
 
 #include "benchmark/benchmark.h"
@@ -10,6 +13,11 @@ namespace {
 constexpr size_t kSetSize = 1000;
 constexpr int kLookingFor = 400;
 
+// From what fits in L1 to ~10 times bigger than LLC.
+constexpr int kMinSetSize = 1 << 12;
+constexpr int kMaxSetSize = 1 << 26;
+constexpr size_t kQueriesCount = 1 << 16;
+
 template <typename I, typename P>
 // requires ForwardIterator<I> && UnaryPredicate<P, ValueType<I>>
 I partition_point_biased_simple(I f, I l, P p) {
@@ -75,6 +83,20 @@ struct sentinal_biased {
   }
 };
 
+struct branchless_search {
+  template <typename I, typename T>
+  I operator()(I f, I l, const T& v) {
+    return lib::lower_bound_branchless(f, l, v);
+  }
+};
+
+struct simd_search {
+  template <typename I, typename T>
+  I operator()(I f, I l, const T& v) {
+    return lib::lower_bound(f, l, v, lib::less{});
+  }
+};
+
 struct binary_search {
   template <typename I, typename T>
   I operator()(I f, I l, const T& v) {
@@ -82,11 +104,65 @@ struct binary_search {
   }
 };
 
+void set_sizes(benchmark::internal::Benchmark* bench) {
+  bench->RangeMultiplier(4)->Range(kMinSetSize, kMaxSetSize);
+}
+
+// Random queries, so that we do not measure the branch predictor.
+template <typename Container>
+void lower_bound_by_size(benchmark::State& state) {
+  const int size = static_cast<int>(state.range(0));
+  std::vector<int> sorted(static_cast<size_t>(size));
+  std::iota(sorted.begin(), sorted.end(), 0);
+  const Container c(sorted.begin(), sorted.end());
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, size - 1);
+  std::vector<int> queries(kQueriesCount);
+  std::generate(queries.begin(), queries.end(), [&] { return dis(g); });
+
+  size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(c.lower_bound(queries[i]));
+    i = (i + 1) % kQueriesCount;
+  }
+}
+
+template <typename SearchPolicy>
+void flat_set_random_lookup(benchmark::State& state) {
+  std::vector<int> sorted(kSetSize);
+  std::iota(sorted.begin(), sorted.end(), 0);
+  const lib::flat_set<int, lib::less, std::vector<int>, SearchPolicy> c(
+      sorted.begin(), sorted.end());
+
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, static_cast<int>(kSetSize));
+  std::vector<int> queries(kQueriesCount);
+  std::generate(queries.begin(), queries.end(), [&] { return dis(g); });
+
+  size_t i = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(c.find(queries[i]));
+    i = (i + 1) % kQueriesCount;
+  }
+}
+
 }  // namespace
 
+BENCHMARK_TEMPLATE(lower_bound_by_size, lib::flat_set<int>)->Apply(set_sizes);
+BENCHMARK_TEMPLATE(lower_bound_by_size, lib::eytzinger_set<int>)
+    ->Apply(set_sizes);
+
 BENCHMARK_TEMPLATE(lower_bound_alg, linear_search);
 BENCHMARK_TEMPLATE(lower_bound_alg, simple_biased);
 BENCHMARK_TEMPLATE(lower_bound_alg, sentinal_biased);
+BENCHMARK_TEMPLATE(lower_bound_alg, branchless_search);
+BENCHMARK_TEMPLATE(lower_bound_alg, simd_search);
 BENCHMARK_TEMPLATE(lower_bound_alg, binary_search);
 
+BENCHMARK_TEMPLATE(flat_set_random_lookup, lib::linear_search_policy);
+BENCHMARK_TEMPLATE(flat_set_random_lookup, lib::biased_search_policy);
+BENCHMARK_TEMPLATE(flat_set_random_lookup, lib::branchless_search_policy);
+BENCHMARK_TEMPLATE(flat_set_random_lookup, lib::binary_search_policy);
+
 BENCHMARK_MAIN();
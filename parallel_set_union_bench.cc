@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kSize = 10 * 1000 * 1000;
+
+using int_vec = std::vector<int>;
+
+int_vec random_set(size_t size) {
+  static std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 4 * kSize);
+
+  int_vec res(size);
+  std::generate(res.begin(), res.end(), [&] { return dis(g); });
+  res.erase(lib::sort_and_unique(res.begin(), res.end()), res.end());
+  return res;
+}
+
+const std::pair<int_vec, int_vec>& input() {
+  static const std::pair<int_vec, int_vec> res{random_set(kSize),
+                                               random_set(kSize)};
+  return res;
+}
+
+void thread_counts(benchmark::internal::Benchmark* bench) {
+  for (int threads : {1, 2, 4, 8, 16})
+    bench->Arg(threads);
+  bench->UseRealTime()->Unit(benchmark::kMillisecond);
+}
+
+void set_union_unbalanced(benchmark::State& state) {
+  const auto& in = input();
+  int_vec out(in.first.size() + in.second.size());
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        lib::set_union_unbalanced(in.first.begin(), in.first.end(),
+                                  in.second.begin(), in.second.end(),
+                                  out.begin()));
+  }
+}
+
+void set_union_parallel(benchmark::State& state) {
+  const auto& in = input();
+  int_vec out(in.first.size() + in.second.size());
+  const size_t threads = static_cast<size_t>(state.range(0));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(lib::set_union_parallel(
+        in.first.begin(), in.first.end(), in.second.begin(), in.second.end(),
+        out.begin(), lib::less{}, threads));
+  }
+}
+
+}  // namespace
+
+BENCHMARK(set_union_unbalanced)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(set_union_parallel)->Apply(thread_counts);
+
+BENCHMARK_MAIN();
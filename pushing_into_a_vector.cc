@@ -3,6 +3,8 @@
 #include <numeric>
 #include <vector>
 
+#include "lib.h"
+
 #include "benchmark/benchmark.h"
 
 namespace {
@@ -41,6 +43,30 @@ void back_inserter(benchmark::State& state) {
   }
 }
 
+void flat_set_insert_end_hint(benchmark::State& state) {
+  std::vector<int> in(kSize);
+  std::iota(in.begin(), in.end(), 0);
+
+  while (state.KeepRunning()) {
+    lib::flat_set<int> c;
+    for (int x : in)
+      c.insert(c.end(), x);
+    benchmark::DoNotOptimize(c);
+  }
+}
+
+void flat_set_insert(benchmark::State& state) {
+  std::vector<int> in(kSize);
+  std::iota(in.begin(), in.end(), 0);
+
+  while (state.KeepRunning()) {
+    lib::flat_set<int> c;
+    for (int x : in)
+      c.insert(x);
+    benchmark::DoNotOptimize(c);
+  }
+}
+
 void do_nothing(benchmark::State& state) {
   while (state.KeepRunning()) {
   }
@@ -51,5 +77,7 @@ void do_nothing(benchmark::State& state) {
 BENCHMARK(insert_f_l);
 BENCHMARK(back_inserter_reserve);
 BENCHMARK(back_inserter);
+BENCHMARK(flat_set_insert_end_hint);
+BENCHMARK(flat_set_insert);
 BENCHMARK(do_nothing);
 BENCHMARK_MAIN();
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <boost/container/flat_set.hpp>
+
+#include "buffered_flat_set.h"
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kInserts = 1 << 12;
+
+// The set has state.range(0) elements, then kInserts random values are
+// inserted one by one. Half of the inserts hit existing elements.
+struct input_t {
+  std::vector<int> initial;
+  std::vector<int> inserts;
+};
+
+input_t make_input(int size) {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 4 * size);
+
+  input_t res;
+  res.initial.resize(static_cast<size_t>(size));
+  std::generate(res.initial.begin(), res.initial.end(), [&] { return dis(g); });
+  res.inserts.resize(kInserts);
+  std::generate(res.inserts.begin(), res.inserts.end(), [&] { return dis(g); });
+  return res;
+}
+
+template <typename Set>
+void random_insert(benchmark::State& state) {
+  const input_t in = make_input(static_cast<int>(state.range(0)));
+
+  // Declared outside of the loop, so the destructor runs while paused.
+  Set c;
+  for (auto _ : state) {
+    state.PauseTiming();
+    c = Set(in.initial.begin(), in.initial.end());
+    state.ResumeTiming();
+
+    for (int x : in.inserts)
+      c.insert(x);
+    // Keeps the inserts from being optimized away.
+    benchmark::DoNotOptimize(*c.begin());
+  }
+  state.SetItemsProcessed(state.iterations() * kInserts);
+}
+
+void set_sizes(benchmark::internal::Benchmark* bench) {
+  for (int size : {1 << 10, 1 << 14, 1 << 18, 1 << 20})
+    bench->Arg(size);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(random_insert, lib::flat_set<int>)->Apply(set_sizes);
+BENCHMARK_TEMPLATE(random_insert, lib::buffered_flat_set<int>)
+    ->Apply(set_sizes);
+BENCHMARK_TEMPLATE(random_insert, boost::container::flat_set<int>)
+    ->Apply(set_sizes);
+BENCHMARK_TEMPLATE(random_insert, std::set<int>)->Apply(set_sizes);
+
+BENCHMARK_MAIN();
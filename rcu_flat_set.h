@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "lib.h"
+
+namespace lib {
+
+// flat_set for many reading threads and rare batched updates, in the style
+// of read-copy-update.
+//
+// Readers take a snapshot: an immutable flat_set behind an atomic pointer.
+// Taking one is a CAS on a reader slot plus an atomic load, nothing is
+// locked and nothing is shared between readers except the slots array.
+// A snapshot stays valid until it is destroyed, whatever the writers do.
+//
+// Writers queue inserts and erases, publish() applies them to a copy of the
+// current version and swaps the pointer. Old versions are freed with epochs:
+// a reader slot holds the epoch at the time the snapshot was taken, a version
+// retired at epoch e is freed when no slot has an epoch before e.
+//
+// When all of the slots are taken, readers count themselves in one shared
+// counter instead of waiting, and nothing is freed while it is not zero.
+template <typename Key,
+          typename Comparator = less,
+          typename UnderlyingType = std::vector<Key>>
+// requires (todo)
+class rcu_flat_set {
+ public:
+  using sorted_type = flat_set<Key, Comparator, UnderlyingType>;
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = typename sorted_type::size_type;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+
+  // Readers that can hold a snapshot with a slot of their own at the same
+  // time. More go to the shared counter.
+  static constexpr size_t kReaderSlots = 256;
+
+ private:
+  // Every slot is on cache lines of its own, readers do not invalidate
+  // each other.
+  struct reader_slot {
+    // 0 - free.
+    std::atomic<std::uint64_t> epoch{0};
+  };
+  using padded_slot = detail::cache_line_padded<reader_slot>;
+
+  struct retired_version {
+    std::unique_ptr<const sorted_type> version;
+    std::uint64_t epoch;
+  };
+
+  std::atomic<const sorted_type*> current_;
+  std::atomic<std::uint64_t> epoch_{1};
+  mutable std::array<padded_slot, kReaderSlots> slots_;
+  // Readers that did not get a slot.
+  mutable detail::cache_line_padded<std::atomic<std::uint64_t>>
+      overflow_readers_{0};
+
+  // Writers' side.
+  std::mutex writer_mutex_;
+  std::vector<std::pair<value_type, bool>> pending_;  // value, is insert
+  std::vector<retired_version> retired_;
+
+  static size_t slot_hint() {
+    static std::atomic<size_t> next_hint{0};
+    thread_local size_t hint = next_hint++ % kReaderSlots;
+    return hint;
+  }
+
+  // One pass over the slots, nullptr if all of them are taken.
+  reader_slot* acquire_slot() const {
+    size_t i = slot_hint();
+    for (size_t tries = 0; tries != kReaderSlots; ++tries) {
+      std::uint64_t free = 0;
+      reader_slot& slot = slots_[i].value;
+      if (slot.epoch.compare_exchange_strong(free, epoch_.load()))
+        return &slot;
+      i = (i + 1) % kReaderSlots;
+    }
+    return nullptr;
+  }
+
+  // A reader in the shared counter can be holding any version.
+  std::uint64_t oldest_reader_epoch() const {
+    if (overflow_readers_.value.load())
+      return 0;
+    std::uint64_t res = UINT64_MAX;
+    for (const auto& slot : slots_) {
+      std::uint64_t epoch = slot.value.epoch.load();
+      if (epoch && epoch < res)
+        res = epoch;
+    }
+    return res;
+  }
+
+  void free_unused_versions() {
+    std::uint64_t oldest = oldest_reader_epoch();
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                  [&](const retired_version& x) {
+                                    return x.epoch <= oldest;
+                                  }),
+                   retired_.end());
+  }
+
+ public:
+  class snapshot {
+   public:
+    snapshot(snapshot&& x) noexcept
+        : slot_(x.slot_), overflow_(x.overflow_), set_(x.set_) {
+      x.slot_ = nullptr;
+      x.overflow_ = nullptr;
+    }
+    snapshot& operator=(snapshot&&) = delete;
+
+    ~snapshot() {
+      if (slot_)
+        slot_->epoch.store(0);
+      if (overflow_)
+        overflow_->fetch_sub(1);
+    }
+
+    const sorted_type& operator*() const { return *set_; }
+    const sorted_type* operator->() const { return set_; }
+
+   private:
+    friend class rcu_flat_set;
+
+    snapshot(reader_slot* slot,
+             std::atomic<std::uint64_t>* overflow,
+             const sorted_type* set)
+        : slot_(slot), overflow_(overflow), set_(set) {}
+
+    // One of the two is set.
+    reader_slot* slot_;
+    std::atomic<std::uint64_t>* overflow_;
+    const sorted_type* set_;
+  };
+
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  rcu_flat_set() : current_(new sorted_type()) {}
+  explicit rcu_flat_set(sorted_type x)
+      : current_(new sorted_type(std::move(x))) {}
+
+  rcu_flat_set(const rcu_flat_set&) = delete;
+  rcu_flat_set& operator=(const rcu_flat_set&) = delete;
+
+  // No snapshots can be alive.
+  ~rcu_flat_set() { delete current_.load(); }
+
+  // --------------------------------------------------------------------------
+  // Readers.
+
+  // The epoch goes into the slot (or the reader into the shared counter)
+  // before the pointer is loaded. So if the writer has already moved to the
+  // next epoch, the reader sees the new version; otherwise the old one is
+  // not freed while the slot is taken.
+  // Wait free: at most kReaderSlots CAS plus one fetch_add.
+  snapshot read() const {
+    if (reader_slot* slot = acquire_slot())
+      return {slot, nullptr, current_.load()};
+    overflow_readers_.value.fetch_add(1);
+    return {nullptr, &overflow_readers_.value, current_.load()};
+  }
+
+  template <typename V>
+  size_type count(const V& v) const {
+    return read()->count(v);
+  }
+
+  size_type size() const { return read()->size(); }
+
+  // --------------------------------------------------------------------------
+  // Writers. Changes are not visible until publish().
+
+  template <typename V>
+  void insert(V&& v) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    pending_.emplace_back(std::forward<V>(v), true);
+  }
+
+  template <typename V>
+  void erase(V&& v) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    pending_.emplace_back(std::forward<V>(v), false);
+  }
+
+  // Applies the queued changes, the last one for a key wins.
+  // Erases are done with subtract, inserts with the sorted_unique insert:
+  // both are merges, so a batch costs O(size() + batch log batch).
+  void publish() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    if (pending_.empty())
+      return;
+
+    auto comp = current_.load()->value_comp();
+    std::stable_sort(pending_.begin(), pending_.end(),
+                     [&](const std::pair<value_type, bool>& x,
+                         const std::pair<value_type, bool>& y) {
+                       return comp(x.first, y.first);
+                     });
+
+    std::vector<value_type> inserts, erases;
+    for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+      auto next = std::next(it);
+      if (next != pending_.end() && !comp(it->first, next->first))
+        continue;
+      (it->second ? inserts : erases).push_back(std::move(it->first));
+    }
+    pending_.clear();
+
+    std::unique_ptr<sorted_type> next(new sorted_type(*current_.load()));
+    next->subtract(erases.begin(), erases.end());
+    next->insert(sorted_unique, std::make_move_iterator(inserts.begin()),
+                 std::make_move_iterator(inserts.end()));
+
+    const sorted_type* old = current_.exchange(next.release());
+    retired_.push_back({std::unique_ptr<const sorted_type>(old),
+                        epoch_.fetch_add(1) + 1});
+    free_unused_versions();
+  }
+
+  // Versions that are waiting for the readers. Readers in the shared
+  // counter hold all of them until the counter drops to zero.
+  size_t retired_versions() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    free_unused_versions();
+    return retired_.size();
+  }
+};
+
+template <typename Key, typename Comparator, typename UnderlyingType>
+constexpr size_t rcu_flat_set<Key, Comparator, UnderlyingType>::kReaderSlots;
+
+}  // namespace lib
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "lib.h"
+#include "rcu_flat_set.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kSetSize = 1 << 20;
+constexpr int kBatchSize = 1000;
+constexpr auto kWriterPause = std::chrono::milliseconds(1);
+
+// Even numbers, the writer only touches odd ones.
+lib::flat_set<int> initial_set() {
+  std::vector<int> res(kSetSize);
+  for (int i = 0; i < kSetSize; ++i)
+    res[static_cast<size_t>(i)] = 2 * i;
+  return lib::flat_set<int>(res.begin(), res.end());
+}
+
+// The ways to share a set between the readers and one writer.
+
+struct mutex_set {
+  std::mutex mutex;
+  lib::flat_set<int> set = initial_set();
+
+  bool contains(int x) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return set.count(x);
+  }
+
+  template <typename I>
+  void insert(I f, I l) {
+    std::lock_guard<std::mutex> lock(mutex);
+    set.insert(f, l);
+  }
+
+  template <typename I>
+  void erase(I f, I l) {
+    std::lock_guard<std::mutex> lock(mutex);
+    set.subtract(f, l);
+  }
+};
+
+struct shared_mutex_set {
+  std::shared_timed_mutex mutex;
+  lib::flat_set<int> set = initial_set();
+
+  bool contains(int x) {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex);
+    return set.count(x);
+  }
+
+  template <typename I>
+  void insert(I f, I l) {
+    std::lock_guard<std::shared_timed_mutex> lock(mutex);
+    set.insert(f, l);
+  }
+
+  template <typename I>
+  void erase(I f, I l) {
+    std::lock_guard<std::shared_timed_mutex> lock(mutex);
+    set.subtract(f, l);
+  }
+};
+
+struct rcu_set {
+  lib::rcu_flat_set<int> set{initial_set()};
+
+  bool contains(int x) { return set.count(x); }
+
+  template <typename I>
+  void insert(I f, I l) {
+    for (; f != l; ++f)
+      set.insert(*f);
+    set.publish();
+  }
+
+  template <typename I>
+  void erase(I f, I l) {
+    for (; f != l; ++f)
+      set.erase(*f);
+    set.publish();
+  }
+};
+
+template <typename Set>
+Set& shared_set() {
+  static Set res;
+  return res;
+}
+
+// Inserts a sorted batch of odd numbers, then erases it, until stopped.
+template <typename Set>
+class writer {
+ public:
+  writer() : thread_([this] { run(); }) {}
+
+  ~writer() {
+    stop_ = true;
+    thread_.join();
+  }
+
+ private:
+  void run() {
+    std::mt19937 g;
+    std::uniform_int_distribution<> dis(0, kSetSize - 1);
+    std::vector<int> batch(kBatchSize);
+    while (!stop_) {
+      for (int& x : batch)
+        x = 2 * dis(g) + 1;
+      std::sort(batch.begin(), batch.end());
+      shared_set<Set>().insert(batch.begin(), batch.end());
+      std::this_thread::sleep_for(kWriterPause);
+      shared_set<Set>().erase(batch.begin(), batch.end());
+      std::this_thread::sleep_for(kWriterPause);
+    }
+  }
+
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+template <typename Set>
+void read_scaling(benchmark::State& state) {
+  Set& set = shared_set<Set>();
+  std::unique_ptr<writer<Set>> w;
+  if (state.thread_index() == 0)
+    w.reset(new writer<Set>);
+
+  std::mt19937 g(static_cast<unsigned>(state.thread_index()));
+  std::uniform_int_distribution<> dis(0, 2 * kSetSize);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(set.contains(dis(g)));
+  state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(read_scaling, mutex_set)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(read_scaling, shared_mutex_set)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(read_scaling, rcu_set)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_MAIN();
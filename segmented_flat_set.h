@@ -0,0 +1,503 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lib.h"
+
+namespace lib {
+
+namespace detail {
+
+template <typename Key>
+class segmented_iterator {
+  using chunks_t = std::vector<std::vector<Key>>;
+
+ public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = Key;
+  using difference_type = std::ptrdiff_t;
+  using reference = const Key&;
+  using pointer = const Key*;
+
+  segmented_iterator() = default;
+  // Chunks are never empty, so (chunk, 0) is a valid position for every
+  // chunk < chunks.size(). end is (chunks.size(), 0).
+  segmented_iterator(const chunks_t* chunks, size_t chunk, size_t pos)
+      : chunks_(chunks), chunk_(chunk), pos_(pos) {
+    if (chunk_ < chunks_->size() && pos_ == (*chunks_)[chunk_].size()) {
+      ++chunk_;
+      pos_ = 0;
+    }
+  }
+
+  size_t chunk() const { return chunk_; }
+  size_t pos() const { return pos_; }
+
+  reference operator*() const { return (*chunks_)[chunk_][pos_]; }
+  pointer operator->() const { return &**this; }
+
+  segmented_iterator& operator++() {
+    if (++pos_ == (*chunks_)[chunk_].size()) {
+      ++chunk_;
+      pos_ = 0;
+    }
+    return *this;
+  }
+
+  segmented_iterator operator++(int) {
+    auto res = *this;
+    ++*this;
+    return res;
+  }
+
+  segmented_iterator& operator--() {
+    if (!pos_) {
+      --chunk_;
+      pos_ = (*chunks_)[chunk_].size();
+    }
+    --pos_;
+    return *this;
+  }
+
+  segmented_iterator operator--(int) {
+    auto res = *this;
+    --*this;
+    return res;
+  }
+
+  friend bool operator==(const segmented_iterator& x,
+                         const segmented_iterator& y) {
+    return x.chunk_ == y.chunk_ && x.pos_ == y.pos_;
+  }
+
+  friend bool operator!=(const segmented_iterator& x,
+                         const segmented_iterator& y) {
+    return !(x == y);
+  }
+
+ private:
+  const chunks_t* chunks_ = nullptr;
+  size_t chunk_ = 0;
+  size_t pos_ = 0;
+};
+
+}  // namespace detail
+
+// Sorted set, stored in chunks of about 4KB.
+// An insert or an erase moves elements only within one chunk, plus the
+// chunk index when a chunk is split or merged with its neighbour. So the
+// worst case insert is O(kChunkSize + size() / kChunkSize) instead of
+// O(size()) for flat_set.
+// Lookups binary search the minimums of the chunks, then the chunk.
+template <typename Key, typename Comparator = less>
+// requires (todo)
+class segmented_flat_set {
+  using chunk_t = std::vector<Key>;
+
+ public:
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+  using reference = const value_type&;
+  using const_reference = const value_type&;
+  using iterator = detail::segmented_iterator<Key>;
+  using const_iterator = iterator;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = reverse_iterator;
+
+  // Full chunk, it is split in two on the next insert.
+  static constexpr size_type kChunkSize =
+      sizeof(Key) < 4096 / 16 ? 4096 / sizeof(Key) : 16;
+
+  // A chunk that gets smaller after an erase is merged with a neighbour.
+  static constexpr size_type kMinChunkSize = kChunkSize / 4;
+
+ private:
+  struct impl_t : value_compare {
+    impl_t() = default;
+
+    explicit impl_t(const value_compare& comp) : value_compare(comp) {}
+
+    std::vector<chunk_t> chunks_;
+    // mins_[i] == chunks_[i].front()
+    std::vector<Key> mins_;
+    size_type size_ = 0;
+  } impl_;
+
+  template <typename V>
+  using type_for_value_compare =
+      typename std::conditional<TransparentComparator<value_compare>(),
+                                V,
+                                value_type>::type;
+
+  std::vector<chunk_t>& chunks() { return impl_.chunks_; }
+  const std::vector<chunk_t>& chunks() const { return impl_.chunks_; }
+  std::vector<Key>& mins() { return impl_.mins_; }
+  const std::vector<Key>& mins() const { return impl_.mins_; }
+
+  const_iterator make_iterator(size_type chunk, size_type pos) const {
+    return {&chunks(), chunk, pos};
+  }
+
+  // The only chunk that can contain v: the last one with min <= v.
+  template <typename V>
+  size_type chunk_for(const V& v) const {
+    auto comp = value_comp();
+    auto pos = std::partition_point(
+        mins().begin(), mins().end(),
+        [&](const Key& min) { return !comp(v, min); });
+    return pos == mins().begin()
+               ? 0
+               : static_cast<size_type>(pos - mins().begin()) - 1;
+  }
+
+  template <typename V>
+  std::pair<size_type, size_type> position_of(const V& v) const {
+    if (chunks().empty())
+      return {0, 0};
+    size_type chunk = chunk_for(v);
+    const chunk_t& c = chunks()[chunk];
+    auto pos = binary_search_policy{}.lower_bound(c.begin(), c.end(), v,
+                                                  value_comp());
+    return {chunk, static_cast<size_type>(pos - c.begin())};
+  }
+
+  // Splits a chunk that got over kChunkSize in two halves.
+  void split(size_type chunk) {
+    chunk_t& c = chunks()[chunk];
+    auto middle = c.begin() + static_cast<difference_type>(c.size() / 2);
+    chunk_t second(std::make_move_iterator(middle),
+                   std::make_move_iterator(c.end()));
+    c.erase(middle, c.end());
+
+    mins().insert(mins().begin() + static_cast<difference_type>(chunk) + 1,
+                  second.front());
+    chunks().insert(chunks().begin() + static_cast<difference_type>(chunk) + 1,
+                    std::move(second));
+  }
+
+  void remove_chunk(size_type chunk) {
+    chunks().erase(chunks().begin() + static_cast<difference_type>(chunk));
+    mins().erase(mins().begin() + static_cast<difference_type>(chunk));
+  }
+
+  // Merges a chunk that got under kMinChunkSize with the previous one (or
+  // the next one, for the first chunk) and splits the result if it is over
+  // kChunkSize. So the number of chunks stays O(size() / kChunkSize).
+  // Returns where the element at (chunk, pos) ended up.
+  std::pair<size_type, size_type> rebalance_after_erase(size_type chunk,
+                                                        size_type pos) {
+    if (chunks()[chunk].empty()) {
+      remove_chunk(chunk);
+      return {chunk, 0};
+    }
+    mins()[chunk] = chunks()[chunk].front();
+
+    if (chunks()[chunk].size() >= kMinChunkSize || chunks().size() == 1)
+      return {chunk, pos};
+
+    if (chunk) {
+      --chunk;
+      pos += chunks()[chunk].size();
+    }
+    chunk_t& c = chunks()[chunk];
+    chunk_t& next = chunks()[chunk + 1];
+    c.insert(c.end(), std::make_move_iterator(next.begin()),
+             std::make_move_iterator(next.end()));
+    remove_chunk(chunk + 1);
+
+    if (c.size() > kChunkSize) {
+      const size_type half = c.size() / 2;
+      split(chunk);
+      if (pos >= half) {
+        ++chunk;
+        pos -= half;
+      }
+    }
+    return {chunk, pos};
+  }
+
+  // Replaces chunks with sorted and unique elements.
+  void assign_sorted(chunk_t& sorted) {
+    chunks().clear();
+    mins().clear();
+    impl_.size_ = sorted.size();
+    append_chunks(sorted.begin(), sorted.end(), chunks(), mins());
+  }
+
+  // Chunks are filled to 3/4: if they were full, every following insert
+  // would split one and shift the chunk index. Elements are spread evenly,
+  // so there is no small chunk at the end.
+  template <typename I>
+  static void append_chunks(I f,
+                            I l,
+                            std::vector<chunk_t>& chunks,
+                            std::vector<Key>& mins) {
+    constexpr auto kFill =
+        static_cast<difference_type>(kChunkSize - kChunkSize / 4);
+    const difference_type total = std::distance(f, l);
+    const difference_type count = (total + kFill - 1) / kFill;
+    for (difference_type i = 0; i < count; ++i) {
+      I chunk_l = f + (total * (i + 1) / count - total * i / count);
+      chunks.emplace_back(std::make_move_iterator(f),
+                          std::make_move_iterator(chunk_l));
+      mins.push_back(chunks.back().front());
+      f = chunk_l;
+    }
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  segmented_flat_set() = default;
+  explicit segmented_flat_set(const key_compare& comp) : impl_{comp} {}
+
+  template <typename I>
+  // requires InputIterator<I>
+  segmented_flat_set(I f, I l, const key_compare& comp = key_compare())
+      : impl_{comp} {
+    chunk_t sorted(f, l);
+    sorted.erase(sort_and_unique(sorted.begin(), sorted.end(), value_comp()),
+                 sorted.end());
+    assign_sorted(sorted);
+  }
+
+  segmented_flat_set(std::initializer_list<value_type> il,
+                     const key_compare& comp = key_compare())
+      : segmented_flat_set(il.begin(), il.end(), comp) {}
+
+  segmented_flat_set(const segmented_flat_set&) = default;
+  segmented_flat_set(segmented_flat_set&&) = default;
+  segmented_flat_set& operator=(const segmented_flat_set&) = default;
+  segmented_flat_set& operator=(segmented_flat_set&&) = default;
+
+  ~segmented_flat_set() = default;
+
+  //---------------------------------------------------------------------------
+  // Size management.
+
+  size_type size() const { return impl_.size_; }
+  bool empty() const { return !size(); }
+
+  size_type chunk_count() const { return chunks().size(); }
+
+  void clear() {
+    chunks().clear();
+    mins().clear();
+    impl_.size_ = 0;
+  }
+
+  //---------------------------------------------------------------------------
+  // Iterators.
+
+  const_iterator begin() const { return make_iterator(0, 0); }
+  const_iterator cbegin() const { return begin(); }
+
+  const_iterator end() const { return make_iterator(chunks().size(), 0); }
+  const_iterator cend() const { return end(); }
+
+  const_reverse_iterator rbegin() const { return reverse_iterator(end()); }
+  const_reverse_iterator crbegin() const { return rbegin(); }
+
+  const_reverse_iterator rend() const { return reverse_iterator(begin()); }
+  const_reverse_iterator crend() const { return rend(); }
+
+  //---------------------------------------------------------------------------
+  // Insert operations.
+
+  template <typename V>
+  std::pair<const_iterator, bool> insert(V&& v) {
+    if (chunks().empty()) {
+      chunks().emplace_back();
+      chunks().back().push_back(std::forward<V>(v));
+      mins().push_back(chunks().back().front());
+      impl_.size_ = 1;
+      return {begin(), true};
+    }
+
+    size_type chunk, pos;
+    std::tie(chunk, pos) = position_of(v);
+    chunk_t& c = chunks()[chunk];
+    if (pos != c.size() && !value_comp()(v, c[pos]))
+      return {make_iterator(chunk, pos), false};
+
+    c.insert(c.begin() + static_cast<difference_type>(pos),
+             std::forward<V>(v));
+    ++impl_.size_;
+    if (!pos)
+      mins()[chunk] = c.front();
+
+    if (c.size() > kChunkSize) {
+      split(chunk);
+      if (pos >= chunks()[chunk].size()) {
+        pos -= chunks()[chunk].size();
+        ++chunk;
+      }
+    }
+    return {make_iterator(chunk, pos), true};
+  }
+
+  template <typename... Args>
+  std::pair<const_iterator, bool> emplace(Args&&... args) {
+    return insert(value_type(std::forward<Args>(args)...));
+  }
+
+  // Sorts the new elements, then merges them into every chunk they fall in
+  // with set_union_unbalanced. Chunks without new elements are moved as is.
+  template <typename I>
+  // requires InputIterator<I>
+  void insert(I f, I l) {
+    chunk_t sorted(f, l);
+    sorted.erase(sort_and_unique(sorted.begin(), sorted.end(), value_comp()),
+                 sorted.end());
+    if (chunks().empty()) {
+      assign_sorted(sorted);
+      return;
+    }
+
+    std::vector<chunk_t> new_chunks;
+    std::vector<Key> new_mins;
+    new_chunks.reserve(chunks().size());
+    new_mins.reserve(chunks().size());
+
+    auto comp = value_comp();
+    auto in_f = sorted.begin();
+    chunk_t merged;
+    for (size_type i = 0; i < chunks().size(); ++i) {
+      auto in_l = sorted.end();
+      if (i + 1 < chunks().size()) {
+        in_l = binary_search_policy{}.lower_bound(in_f, sorted.end(),
+                                                  mins()[i + 1], comp);
+      }
+
+      chunk_t& c = chunks()[i];
+      if (in_f == in_l) {
+        new_chunks.push_back(std::move(c));
+        new_mins.push_back(std::move(mins()[i]));
+        continue;
+      }
+
+      merged.clear();
+      merged.reserve(c.size() + static_cast<size_type>(in_l - in_f));
+      set_union_unbalanced(std::make_move_iterator(c.begin()),
+                           std::make_move_iterator(c.end()),
+                           std::make_move_iterator(in_f),
+                           std::make_move_iterator(in_l),
+                           std::back_inserter(merged), comp);
+      impl_.size_ += merged.size() - c.size();
+      append_chunks(merged.begin(), merged.end(), new_chunks, new_mins);
+      in_f = in_l;
+    }
+
+    chunks().swap(new_chunks);
+    mins().swap(new_mins);
+  }
+
+  // --------------------------------------------------------------------------
+  // Erase operations.
+
+  template <typename V>
+  size_type erase(const V& v) {
+    auto it = find(v);
+    if (it == end())
+      return 0;
+    erase(it);
+    return 1;
+  }
+
+  const_iterator erase(const_iterator pos) {
+    size_type chunk = pos.chunk();
+    chunk_t& c = chunks()[chunk];
+    c.erase(c.begin() + static_cast<difference_type>(pos.pos()));
+    --impl_.size_;
+
+    auto next = rebalance_after_erase(chunk, pos.pos());
+    return make_iterator(next.first, next.second);
+  }
+
+  // --------------------------------------------------------------------------
+  // Search operations.
+
+  template <typename V>
+  size_type count(const V& v) const {
+    return find(v) == end() ? 0 : 1;
+  }
+
+  template <typename V>
+  bool contains(const V& v) const {
+    return count(v);
+  }
+
+  template <typename V>
+  const_iterator find(const V& v) const {
+    auto pos = lower_bound(v);
+    if (pos == end() || value_comp()(v, *pos))
+      return end();
+    return pos;
+  }
+
+  template <typename V>
+  const_iterator lower_bound(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    auto chunk_pos = position_of(v_ref);
+    return make_iterator(chunk_pos.first, chunk_pos.second);
+  }
+
+  template <typename V>
+  const_iterator upper_bound(const V& v) const {
+    auto pos = lower_bound(v);
+    if (pos != end() && !value_comp()(v, *pos))
+      ++pos;
+    return pos;
+  }
+
+  //---------------------------------------------------------------------------
+  // Getters.
+
+  key_compare key_comp() const { return impl_; }
+  value_compare value_comp() const { return impl_; }
+
+  //---------------------------------------------------------------------------
+  // General operations.
+
+  void swap(segmented_flat_set& x) {
+    impl_.chunks_.swap(x.impl_.chunks_);
+    impl_.mins_.swap(x.impl_.mins_);
+    std::swap(impl_.size_, x.impl_.size_);
+  }
+
+  friend void swap(segmented_flat_set& x, segmented_flat_set& y) {
+    x.swap(y);
+  }
+
+  friend bool operator==(const segmented_flat_set& x,
+                         const segmented_flat_set& y) {
+    return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend bool operator!=(const segmented_flat_set& x,
+                         const segmented_flat_set& y) {
+    return !(x == y);
+  }
+};
+
+template <typename Key, typename Comparator>
+constexpr typename segmented_flat_set<Key, Comparator>::size_type
+    segmented_flat_set<Key, Comparator>::kChunkSize;
+
+template <typename Key, typename Comparator>
+constexpr typename segmented_flat_set<Key, Comparator>::size_type
+    segmented_flat_set<Key, Comparator>::kMinChunkSize;
+
+}  // namespace lib
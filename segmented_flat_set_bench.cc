@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "lib.h"
+#include "segmented_flat_set.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kOperations = 1000;
+
+struct input_t {
+  std::vector<int> initial;
+  std::vector<int> operations;
+};
+
+input_t make_input(int size) {
+  std::mt19937 g;
+  std::uniform_int_distribution<> dis(0, 2 * size);
+
+  input_t res;
+  res.initial.resize(static_cast<size_t>(size));
+  std::generate(res.initial.begin(), res.initial.end(), [&] { return dis(g); });
+  res.operations.resize(kOperations);
+  std::generate(res.operations.begin(), res.operations.end(),
+                [&] { return dis(g); });
+  return res;
+}
+
+// Times every insert separately and reports the percentiles in ns.
+template <typename Set>
+void insert_latency(benchmark::State& state) {
+  const input_t in = make_input(static_cast<int>(state.range(0)));
+  std::vector<double> latencies;
+
+  // Declared outside of the loop, so the destructor runs while paused.
+  Set c;
+  for (auto _ : state) {
+    state.PauseTiming();
+    c = Set(in.initial.begin(), in.initial.end());
+    state.ResumeTiming();
+
+    for (int x : in.operations) {
+      auto start = std::chrono::steady_clock::now();
+      benchmark::DoNotOptimize(c.insert(x));
+      auto stop = std::chrono::steady_clock::now();
+      latencies.push_back(
+          std::chrono::duration<double, std::nano>(stop - start).count());
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["max_ns"] = latencies.back();
+}
+
+template <typename Set>
+void lookup(benchmark::State& state) {
+  const input_t in = make_input(static_cast<int>(state.range(0)));
+  const Set c(in.initial.begin(), in.initial.end());
+
+  for (auto _ : state) {
+    for (int x : in.operations)
+      benchmark::DoNotOptimize(c.count(x));
+  }
+  state.SetItemsProcessed(state.iterations() * kOperations);
+}
+
+void set_sizes(benchmark::internal::Benchmark* bench) {
+  for (int size : {1 << 16, 1 << 20, 1 << 24, 50 * 1000 * 1000})
+    bench->Arg(size);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(insert_latency, lib::flat_set<int>)
+    ->Apply(set_sizes)
+    ->Iterations(1);
+BENCHMARK_TEMPLATE(insert_latency, lib::segmented_flat_set<int>)
+    ->Apply(set_sizes)
+    ->Iterations(1);
+BENCHMARK_TEMPLATE(lookup, lib::flat_set<int>)->Apply(set_sizes);
+BENCHMARK_TEMPLATE(lookup, lib::segmented_flat_set<int>)->Apply(set_sizes);
+
+BENCHMARK_MAIN();
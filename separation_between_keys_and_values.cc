@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "bench_utils.h"
+#include "lib.h"
 #include "benchmark/benchmark.h"
 
 
@@ -49,6 +50,17 @@ void two_vectors(benchmark::State& state) {
     ++(look_for_mapped_value(keys, values));
 }
 
+template <typename T>
+// requires UnsignedIntegral<T>
+void lib_flat_map(benchmark::State& state) {
+  std::vector<int> keys(kSetSize);
+  std::iota(keys.begin(), keys.end(), 0);
+  lib::flat_map<int, T> cont(std::move(keys), std::vector<T>(kSetSize));
+
+  while (state.KeepRunning())
+    ++(cont.find(kLookingFor)->second);
+}
+
 void do_nothing(benchmark::State& state) {
   while (state.KeepRunning());
 }
@@ -57,8 +69,10 @@ void do_nothing(benchmark::State& state) {
 
 BENCHMARK_TEMPLATE(single_vector, unsigned);
 BENCHMARK_TEMPLATE(two_vectors, unsigned);
+BENCHMARK_TEMPLATE(lib_flat_map, unsigned);
 BENCHMARK_TEMPLATE(single_vector, padded_int<unsigned>);
 BENCHMARK_TEMPLATE(two_vectors, padded_int<unsigned>);
+BENCHMARK_TEMPLATE(lib_flat_map, padded_int<unsigned>);
 BENCHMARK(do_nothing);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+using int_vec = std::vector<int>;
+
+constexpr size_t kTotalSize = 1 << 20;
+
+// state.range(0) ranges of kTotalSize / k elements each.
+// Interleaved: every range has values from everywhere.
+// Clustered: range i has the values around i * kTotalSize / k, so there are
+// long streaks from one range.
+std::vector<int_vec> make_ranges(size_t k, bool clustered) {
+  std::mt19937 g;
+  const size_t size = kTotalSize / k;
+  std::vector<int_vec> res(k);
+  for (size_t i = 0; i < k; ++i) {
+    int from = clustered ? static_cast<int>(i * size) : 0;
+    int to = clustered ? static_cast<int>((i + 2) * size)
+                       : static_cast<int>(kTotalSize);
+    std::uniform_int_distribution<> dis(from, to);
+    res[i].resize(size);
+    std::generate(res[i].begin(), res[i].end(), [&] { return dis(g); });
+    res[i].erase(lib::sort_and_unique(res[i].begin(), res[i].end()),
+                 res[i].end());
+  }
+  return res;
+}
+
+struct pairwise {
+  int_vec operator()(const std::vector<int_vec>& ranges) {
+    int_vec res, tmp;
+    for (const auto& r : ranges) {
+      tmp.resize(res.size() + r.size());
+      tmp.erase(lib::set_union_unbalanced(res.begin(), res.end(), r.begin(),
+                                          r.end(), tmp.begin()),
+                tmp.end());
+      res.swap(tmp);
+    }
+    return res;
+  }
+};
+
+struct concatenate_and_sort {
+  int_vec operator()(const std::vector<int_vec>& ranges) {
+    int_vec res;
+    for (const auto& r : ranges)
+      res.insert(res.end(), r.begin(), r.end());
+    res.erase(lib::sort_and_unique(res.begin(), res.end()), res.end());
+    return res;
+  }
+};
+
+struct set_union_n {
+  int_vec operator()(const std::vector<int_vec>& ranges) {
+    lib::flat_set<int> res(lib::sorted_unique_ranges, ranges.begin(),
+                           ranges.end());
+    return std::move(res.body());
+  }
+};
+
+template <typename Alg>
+void union_of(benchmark::State& state, bool clustered) {
+  const auto ranges = make_ranges(static_cast<size_t>(state.range(0)),
+                                  clustered);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(Alg{}(ranges));
+}
+
+template <typename Alg>
+void interleaved(benchmark::State& state) {
+  union_of<Alg>(state, false);
+}
+
+template <typename Alg>
+void clustered(benchmark::State& state) {
+  union_of<Alg>(state, true);
+}
+
+void ks(benchmark::internal::Benchmark* bench) {
+  for (int k : {16, 64, 256})
+    bench->Arg(k);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(interleaved, pairwise)->Apply(ks);
+BENCHMARK_TEMPLATE(interleaved, concatenate_and_sort)->Apply(ks);
+BENCHMARK_TEMPLATE(interleaved, set_union_n)->Apply(ks);
+BENCHMARK_TEMPLATE(clustered, pairwise)->Apply(ks);
+BENCHMARK_TEMPLATE(clustered, concatenate_and_sort)->Apply(ks);
+BENCHMARK_TEMPLATE(clustered, set_union_n)->Apply(ks);
+
+BENCHMARK_MAIN();
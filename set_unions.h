@@ -1,8 +1,14 @@
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <type_traits>
 #include <iterator>
+#include <vector>
+
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 
 // Workaround https://bugs.llvm.org/show_bug.cgi?id=35202
 template <typename P>
@@ -424,3 +430,214 @@ copyFirst:
 
 }  // namespace v11
 
+
+namespace v12 {
+
+// Merges 4 elements at a time with a bitonic network in SSE registers and
+// drops duplicates before storing. Only for 32 bit integers with
+// std::less<>, everything else - and inputs of very different sizes, where
+// galloping wins - goes to v11.
+//
+// The output has to have space for (l1 - f1) + (l2 - f2) elements: the
+// kernel stores whole registers.
+
+template <typename T, typename I>
+struct is_contiguous_iterator_to
+    : std::integral_constant<
+          bool,
+          std::is_same<I, T*>::value || std::is_same<I, const T*>::value ||
+              std::is_same<I, typename std::vector<T>::iterator>::value ||
+              std::is_same<I, typename std::vector<T>::const_iterator>::value> {
+};
+
+template <typename I1, typename I2, typename O, typename Comp>
+using can_use_simd = std::integral_constant<bool,
+  std::is_same<typename std::iterator_traits<I1>::value_type,
+               typename std::iterator_traits<I2>::value_type>::value &&
+  (std::is_same<typename std::iterator_traits<I1>::value_type,
+                std::int32_t>::value ||
+   std::is_same<typename std::iterator_traits<I1>::value_type,
+                std::uint32_t>::value) &&
+  is_contiguous_iterator_to<
+      typename std::iterator_traits<I1>::value_type, I1>::value &&
+  is_contiguous_iterator_to<
+      typename std::iterator_traits<I1>::value_type, I2>::value &&
+  is_contiguous_iterator_to<
+      typename std::iterator_traits<I1>::value_type, O>::value &&
+  is_total_ordering<Comp>::value>;
+
+// If one side is this many times smaller, v11 skips over the bigger one.
+constexpr std::ptrdiff_t kUnbalancedRatio = 8;
+
+#if defined(__SSE4_1__)
+
+template <typename T>
+struct simd_ops;
+
+template <>
+struct simd_ops<std::int32_t> {
+  static __m128i min(__m128i x, __m128i y) { return _mm_min_epi32(x, y); }
+  static __m128i max(__m128i x, __m128i y) { return _mm_max_epi32(x, y); }
+};
+
+template <>
+struct simd_ops<std::uint32_t> {
+  static __m128i min(__m128i x, __m128i y) { return _mm_min_epu32(x, y); }
+  static __m128i max(__m128i x, __m128i y) { return _mm_max_epu32(x, y); }
+};
+
+// Both inputs are sorted. After: lo - 4 smallest, hi - 4 biggest, sorted.
+template <typename T>
+inline void bitonic_merge(__m128i& lo, __m128i& hi) {
+  using ops = simd_ops<T>;
+
+  // Reversed hi + lo is a bitonic sequence.
+  hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(0, 1, 2, 3));
+  __m128i l1 = ops::min(lo, hi);
+  __m128i h1 = ops::max(lo, hi);
+
+  // Distance 2: [l0 l1 h0 h1] vs [l2 l3 h2 h3].
+  __m128i a2 = _mm_unpacklo_epi64(l1, h1);
+  __m128i b2 = _mm_unpackhi_epi64(l1, h1);
+  __m128i l2 = ops::min(a2, b2);
+  __m128i h2 = ops::max(a2, b2);
+
+  // Distance 1.
+  __m128i t0 = _mm_unpacklo_epi32(l2, h2);
+  __m128i t1 = _mm_unpackhi_epi32(l2, h2);
+  __m128i a3 = _mm_unpacklo_epi64(t0, t1);
+  __m128i b3 = _mm_unpackhi_epi64(t0, t1);
+  __m128i l3 = ops::min(a3, b3);
+  __m128i h3 = ops::max(a3, b3);
+
+  lo = _mm_unpacklo_epi32(l3, h3);
+  hi = _mm_unpackhi_epi32(l3, h3);
+}
+
+// pshufb masks that move the kept lanes to the front.
+struct compress_table {
+  compress_table() {
+    for (int mask = 0; mask < 16; ++mask) {
+      std::uint8_t bytes[16] = {};
+      int out = 0;
+      for (int lane = 0; lane < 4; ++lane) {
+        if (!(mask & (1 << lane)))
+          continue;
+        for (int b = 0; b < 4; ++b)
+          bytes[out * 4 + b] = static_cast<std::uint8_t>(lane * 4 + b);
+        ++out;
+      }
+      shuffles[mask] =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+      sizes[mask] = out;
+    }
+  }
+
+  __m128i shuffles[16];
+  int sizes[16];
+};
+
+// Drops elements equal to the previous one. The last lane of prev is the
+// last element we stored.
+template <typename T>
+inline T* store_unique(__m128i x, __m128i prev, T* o,
+                       const compress_table& table) {
+  __m128i shifted = _mm_alignr_epi8(x, prev, 12);
+  int keep = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, shifted))) &
+             0xF;
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(o),
+                   _mm_shuffle_epi8(x, table.shuffles[keep]));
+  return o + table.sizes[keep];
+}
+
+template <typename T>
+T* set_union_simd(const T* f1, const T* l1, const T* f2, const T* l2, T* o) {
+  static const compress_table table;
+
+  auto load = [](const T* f) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(f));
+  };
+
+  __m128i lo = load(f1);
+  __m128i hi = load(f2);
+  __m128i prev = _mm_set1_epi32(static_cast<std::int32_t>(~std::min(*f1, *f2)));
+  f1 += 4;
+  f2 += 4;
+
+  while (true) {
+    bitonic_merge<T>(lo, hi);
+    o = store_unique(lo, prev, o, table);
+    prev = lo;
+    lo = hi;
+
+    // The next block comes from the input with the smaller head.
+    const bool take_first = f2 == l2 || (f1 != l1 && *f1 <= *f2);
+    if (take_first) {
+      if (l1 - f1 < 4) break;
+      hi = load(f1);
+      f1 += 4;
+    } else {
+      if (l2 - f2 < 4) break;
+      hi = load(f2);
+      f2 += 4;
+    }
+  }
+
+  // Scalar tail: what is left in the register and both of the inputs.
+  alignas(16) T tmp[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(tmp), lo);
+  T last = static_cast<T>(_mm_extract_epi32(prev, 3));
+
+  auto emit = [&](T x) {
+    if (x == last) return;
+    *o++ = x;
+    last = x;
+  };
+
+  for (const T* h = tmp; h != tmp + 4;) {
+    if (f1 != l1 && *f1 < *h && (f2 == l2 || *f1 <= *f2))
+      emit(*f1++);
+    else if (f2 != l2 && *f2 < *h)
+      emit(*f2++);
+    else
+      emit(*h++);
+  }
+
+  if (f1 != l1 && *f1 == last) ++f1;
+  if (f2 != l2 && *f2 == last) ++f2;
+  return v11::set_union(f1, l1, f2, l2, o, std::less<>{});
+}
+
+template <class I1, class I2, class O, class Comp>
+O set_union(I1 f1, I1 l1, I2 f2, I2 l2, O o, Comp comp, std::true_type) {
+  auto len1 = std::distance(f1, l1);
+  auto len2 = std::distance(f2, l2);
+  if (len1 < 4 || len2 < 4 ||
+      len1 * kUnbalancedRatio < len2 || len2 * kUnbalancedRatio < len1)
+    return v11::set_union(f1, l1, f2, l2, o, comp);
+
+  auto* out = &*o;
+  return o + (set_union_simd(&*f1, &*f1 + len1, &*f2, &*f2 + len2, out) - out);
+}
+
+#else
+
+template <class I1, class I2, class O, class Comp>
+O set_union(I1 f1, I1 l1, I2 f2, I2 l2, O o, Comp comp, std::true_type) {
+  return v11::set_union(f1, l1, f2, l2, o, comp);
+}
+
+#endif  // defined(__SSE4_1__)
+
+template <class I1, class I2, class O, class Comp>
+O set_union(I1 f1, I1 l1, I2 f2, I2 l2, O o, Comp comp, std::false_type) {
+  return v11::set_union(f1, l1, f2, l2, o, comp);
+}
+
+template <class I1, class I2, class O, class Comp>
+O set_union(I1 f1, I1 l1, I2 f2, I2 l2, O o, Comp comp) {
+  return v12::set_union(f1, l1, f2, l2, o, comp,
+                        can_use_simd<I1, I2, O, Comp>{});
+}
+
+}  // namespace v12
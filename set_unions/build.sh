@@ -1,9 +1,11 @@
-clang++ --std=c++14 -O2 -Werror  -Wall \
+clang++ --std=c++14 -O2 -msse4.2 -Werror  -Wall \
          set_unions/baseline.cc  \
          set_unions/common.cc    \
          set_unions/current.cc   \
          set_unions/linear.cc    \
          set_unions/previous.cc  \
+         set_unions/set_operations.cc \
+         set_unions/simd.cc      \
   -I /space/flat_containers_presentation        \
   -I /space/google_benchmark/benchmark/include/ \
   -I /space/chromium/src/                       \
@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#include "lib.h"
+#include "set_unions/common.h"
+
+// set_union_bench only runs Alg on the sweep inputs, other set operations
+// fit it as well.
+
+struct std_set_intersection {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    return std::set_intersection(f1, l1, f2, l2, o);
+  }
+};
+
+struct unbalanced_set_intersection {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    return lib::set_intersection_unbalanced(f1, l1, f2, l2, o);
+  }
+};
+
+struct std_set_difference {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    return std::set_difference(f1, l1, f2, l2, o);
+  }
+};
+
+struct unbalanced_set_difference {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    return lib::set_difference_unbalanced(f1, l1, f2, l2, o);
+  }
+};
+
+struct std_set_symmetric_difference {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    return std::set_symmetric_difference(f1, l1, f2, l2, o);
+  }
+};
+
+struct unbalanced_set_symmetric_difference {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    return lib::set_symmetric_difference_unbalanced(f1, l1, f2, l2, o);
+  }
+};
+
+// Copies lhs to the output, then compacts it in place.
+struct in_place_intersect_with {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    lib::flat_set<int> c(lib::sorted_unique, f1, l1);
+    c.intersect_with(f2, l2);
+    return std::copy(c.begin(), c.end(), o);
+  }
+};
+
+struct in_place_subtract {
+  template <typename I1, typename I2, typename O>
+  O operator()(I1 f1, I1 l1, I2 f2, I2 l2, O o) {
+    lib::flat_set<int> c(lib::sorted_unique, f1, l1);
+    c.subtract(f2, l2);
+    return std::copy(c.begin(), c.end(), o);
+  }
+};
+
+void StdSetIntersection(benchmark::State& state) {
+  set_union_bench<std_set_intersection>(state);
+}
+
+void UnbalancedSetIntersection(benchmark::State& state) {
+  set_union_bench<unbalanced_set_intersection>(state);
+}
+
+void InPlaceIntersectWith(benchmark::State& state) {
+  set_union_bench<in_place_intersect_with>(state);
+}
+
+void StdSetDifference(benchmark::State& state) {
+  set_union_bench<std_set_difference>(state);
+}
+
+void UnbalancedSetDifference(benchmark::State& state) {
+  set_union_bench<unbalanced_set_difference>(state);
+}
+
+void InPlaceSubtract(benchmark::State& state) {
+  set_union_bench<in_place_subtract>(state);
+}
+
+void StdSetSymmetricDifference(benchmark::State& state) {
+  set_union_bench<std_set_symmetric_difference>(state);
+}
+
+void UnbalancedSetSymmetricDifference(benchmark::State& state) {
+  set_union_bench<unbalanced_set_symmetric_difference>(state);
+}
+
+BENCHMARK(StdSetIntersection)->Apply(set_input_sizes);
+BENCHMARK(UnbalancedSetIntersection)->Apply(set_input_sizes);
+BENCHMARK(InPlaceIntersectWith)->Apply(set_input_sizes);
+BENCHMARK(StdSetDifference)->Apply(set_input_sizes);
+BENCHMARK(UnbalancedSetDifference)->Apply(set_input_sizes);
+BENCHMARK(InPlaceSubtract)->Apply(set_input_sizes);
+BENCHMARK(StdSetSymmetricDifference)->Apply(set_input_sizes);
+BENCHMARK(UnbalancedSetSymmetricDifference)->Apply(set_input_sizes);
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <iterator>
 #include <random>
@@ -185,3 +186,36 @@ TEST_CASE("v10_set_union", "[set_unions]") {
     return v10::set_union(f1, l1, f2, l2, o, std::less<>{});
   });
 }
+
+TEST_CASE("v12_set_union", "[set_unions]") {
+  set_union_test([](auto f1, auto l1, auto f2, auto l2, auto o) {
+    return v12::set_union(f1, l1, f2, l2, o, std::less<>{});
+  });
+}
+
+TEST_CASE("v12_set_union_unsigned", "[set_unions]") {
+  std::mt19937 g;
+  std::uniform_int_distribution<std::uint32_t> dis(0xFFFFFF00u, 0xFFFFFFFFu);
+
+  for (size_t lhs_size = 0; lhs_size < 100; lhs_size += 3) {
+    for (size_t rhs_size = 0; rhs_size < 100; rhs_size += 3) {
+      std::vector<std::uint32_t> lhs(lhs_size), rhs(rhs_size);
+      std::generate(lhs.begin(), lhs.end(), [&] { return dis(g); });
+      std::generate(rhs.begin(), rhs.end(), [&] { return dis(g); });
+      std::sort(lhs.begin(), lhs.end());
+      lhs.erase(std::unique(lhs.begin(), lhs.end()), lhs.end());
+      std::sort(rhs.begin(), rhs.end());
+      rhs.erase(std::unique(rhs.begin(), rhs.end()), rhs.end());
+
+      std::vector<std::uint32_t> expected;
+      std::set_union(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                     std::back_inserter(expected));
+
+      std::vector<std::uint32_t> actual(lhs.size() + rhs.size());
+      actual.erase(v12::set_union(lhs.begin(), lhs.end(), rhs.begin(),
+                                  rhs.end(), actual.begin(), std::less<>{}),
+                   actual.end());
+      REQUIRE(expected == actual);
+    }
+  }
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lib.h"
+
+namespace lib {
+
+// flat_set for many writing threads: the keys are split into ranges, every
+// range is a separate flat_set (shard) with its own mutex. Writers to
+// different shards do not wait for each other, and every insert moves only
+// the elements of one shard.
+//
+// Shard boundaries follow the data. When a shard grows past twice the
+// average size at the last rebalance, all of the elements are redistributed
+// evenly. Until the first rebalance everything is in the first shard.
+//
+// Every operation holds the layout lock shared, rebalance holds it
+// exclusively. Shard mutexes are only taken under the layout lock, one at a
+// time (or one per thread in the bulk insert), so there are no deadlocks.
+template <typename Key,
+          typename Comparator = less,
+          typename UnderlyingType = std::vector<Key>>
+// requires (todo)
+class sharded_flat_set {
+ public:
+  using sorted_type = flat_set<Key, Comparator, UnderlyingType>;
+  using underlying_type = UnderlyingType;
+  using key_type = Key;
+  using value_type = key_type;
+  using size_type = typename underlying_type::size_type;
+  using key_compare = Comparator;
+  using value_compare = Comparator;
+
+  static constexpr size_t kDefaultShardCount = 16;
+
+  // Shards are not split before this size, so that small sets do not
+  // rebalance all the time.
+  static constexpr size_t kMinSplitSize = 1024;
+
+ private:
+  struct shard {
+    std::mutex mutex;
+    sorted_type set;
+
+    explicit shard(const value_compare& comp) : set(comp) {}
+  };
+  // Shards are allocated one by one, the padding keeps the mutexes of
+  // different shards and of the neighbouring heap blocks on different cache
+  // lines.
+  using padded_shard = detail::cache_line_padded<shard>;
+
+  struct impl_t : value_compare {
+    explicit impl_t(const value_compare& comp) : value_compare(comp) {}
+
+    // Shard i has keys from [bounds_[i - 1], bounds_[i]).
+    std::vector<key_type> bounds_;
+    std::vector<std::unique_ptr<padded_shard>> shards_;
+  } impl_;
+
+  mutable std::shared_timed_mutex layout_mutex_;
+  std::atomic<size_t> split_size_{kMinSplitSize};
+
+  template <typename V>
+  using type_for_value_compare =
+      typename std::conditional<TransparentComparator<value_compare>(),
+                                V,
+                                value_type>::type;
+
+  template <typename V>
+  shard& shard_for(const V& v) const {
+    const type_for_value_compare<V>& v_ref = v;
+    auto comp = value_comp();
+    auto pos = std::upper_bound(
+        impl_.bounds_.begin(), impl_.bounds_.end(), v_ref,
+        [&](const type_for_value_compare<V>& x, const key_type& bound) {
+          return comp(x, bound);
+        });
+    return impl_.shards_[static_cast<size_t>(pos - impl_.bounds_.begin())]
+        ->value;
+  }
+
+  bool too_big(const shard& s) const {
+    return s.set.size() > split_size_.load(std::memory_order_relaxed);
+  }
+
+  void rebalance() {
+    std::lock_guard<std::shared_timed_mutex> layout(layout_mutex_);
+    // Somebody could have rebalanced while we were waiting.
+    if (std::none_of(impl_.shards_.begin(), impl_.shards_.end(),
+                     [&](const std::unique_ptr<padded_shard>& s) {
+                       return too_big(s->value);
+                     }))
+      return;
+
+    underlying_type all;
+    all.reserve(unsafe_size());
+    for (auto& s : impl_.shards_) {
+      all.insert(all.end(), std::make_move_iterator(s->value.set.begin()),
+                 std::make_move_iterator(s->value.set.end()));
+      s->value.set.clear();
+    }
+
+    const size_t n = all.size();
+    const size_t shards = impl_.shards_.size();
+    impl_.bounds_.clear();
+    for (size_t i = 1; i < shards; ++i)
+      impl_.bounds_.push_back(all[i * n / shards]);
+
+    for (size_t i = 0; i < shards; ++i) {
+      auto f = std::make_move_iterator(all.begin() + i * n / shards);
+      auto l = std::make_move_iterator(all.begin() + (i + 1) * n / shards);
+      impl_.shards_[i]->value.set.insert(sorted_unique, f, l);
+    }
+    split_size_ = std::max(2 * n / shards, kMinSplitSize);
+  }
+
+  size_type unsafe_size() const {
+    size_type res = 0;
+    for (const auto& s : impl_.shards_)
+      res += s->value.set.size();
+    return res;
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Lifetime -----------------------------------------------------------------
+
+  explicit sharded_flat_set(size_t shard_count = kDefaultShardCount,
+                            const key_compare& comp = key_compare())
+      : impl_{comp} {
+    assert(shard_count > 0);
+    impl_.shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i)
+      impl_.shards_.emplace_back(new padded_shard(comp));
+  }
+
+  sharded_flat_set(const sharded_flat_set&) = delete;
+  sharded_flat_set& operator=(const sharded_flat_set&) = delete;
+
+  //---------------------------------------------------------------------------
+  // Size management.
+
+  // Exact only if there are no concurrent writers.
+  size_type size() const {
+    std::shared_lock<std::shared_timed_mutex> layout(layout_mutex_);
+    size_type res = 0;
+    for (const auto& s : impl_.shards_) {
+      std::lock_guard<std::mutex> lock(s->value.mutex);
+      res += s->value.set.size();
+    }
+    return res;
+  }
+
+  bool empty() const { return !size(); }
+
+  size_t shard_count() const { return impl_.shards_.size(); }
+
+  std::vector<size_type> shard_sizes() const {
+    std::shared_lock<std::shared_timed_mutex> layout(layout_mutex_);
+    std::vector<size_type> res;
+    for (const auto& s : impl_.shards_) {
+      std::lock_guard<std::mutex> lock(s->value.mutex);
+      res.push_back(s->value.set.size());
+    }
+    return res;
+  }
+
+  //---------------------------------------------------------------------------
+  // Insert operations.
+
+  template <typename V>
+  bool insert(V&& v) {
+    bool inserted, split;
+    {
+      std::shared_lock<std::shared_timed_mutex> layout(layout_mutex_);
+      shard& s = shard_for(v);
+      std::lock_guard<std::mutex> lock(s.mutex);
+      inserted = s.set.insert(std::forward<V>(v)).second;
+      split = too_big(s);
+    }
+    if (split)
+      rebalance();
+    return inserted;
+  }
+
+  // Sorts the batch, cuts it at the shard boundaries and merges every part
+  // into its shard with the galloping union.
+  template <typename I>
+  // requires InputIterator<I>
+  void insert(I f, I l) {
+    insert_batch(f, l, 1);
+  }
+
+  // insert(f, l) that merges big batches on up to p.num_threads threads, a
+  // shard per thread at a time.
+  template <typename I>
+  // requires InputIterator<I>
+  void insert(parallel_t p, I f, I l) {
+    insert_batch(f, l, p.num_threads);
+  }
+
+ private:
+  template <typename I>
+  void insert_batch(I f, I l, size_t max_threads) {
+    underlying_type batch(f, l);
+    batch.erase(sort_and_unique(batch.begin(), batch.end(), value_comp()),
+                batch.end());
+    if (batch.empty())
+      return;
+
+    std::atomic<bool> split{false};
+    {
+      std::shared_lock<std::shared_timed_mutex> layout(layout_mutex_);
+      auto comp = value_comp();
+      const size_t shards = impl_.shards_.size();
+
+      // cuts[i] is where the part for the shard i starts.
+      std::vector<Iterator<underlying_type>> cuts{batch.begin()};
+      for (const auto& bound : impl_.bounds_)
+        cuts.push_back(std::lower_bound(cuts.back(), batch.end(), bound, comp));
+      cuts.resize(shards + 1, batch.end());
+
+      size_t num_threads = 1;
+      if (batch.size() >= kParallelSetUnionThreshold)
+        num_threads = std::max<size_t>(std::min(max_threads, shards), 1);
+
+      detail::parallel_for(num_threads, [&](size_t k) {
+        for (size_t i = k; i < shards; i += num_threads) {
+          if (cuts[i] == cuts[i + 1])
+            continue;
+          shard& s = impl_.shards_[i]->value;
+          std::lock_guard<std::mutex> lock(s.mutex);
+          s.set.insert(sorted_unique, std::make_move_iterator(cuts[i]),
+                       std::make_move_iterator(cuts[i + 1]));
+          if (too_big(s))
+            split = true;
+        }
+      });
+    }
+    if (split)
+      rebalance();
+  }
+
+ public:
+  // --------------------------------------------------------------------------
+  // Erase operations. Shards are not merged back, the next rebalance takes
+  // care of the empty ones.
+
+  template <typename V>
+  size_type erase(const V& v) {
+    std::shared_lock<std::shared_timed_mutex> layout(layout_mutex_);
+    shard& s = shard_for(v);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.set.erase(v);
+  }
+
+  void clear() {
+    std::lock_guard<std::shared_timed_mutex> layout(layout_mutex_);
+    for (auto& s : impl_.shards_)
+      s->value.set.clear();
+    impl_.bounds_.clear();
+    split_size_ = kMinSplitSize;
+  }
+
+  // --------------------------------------------------------------------------
+  // Search operations.
+
+  template <typename V>
+  size_type count(const V& v) const {
+    std::shared_lock<std::shared_timed_mutex> layout(layout_mutex_);
+    shard& s = shard_for(v);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.set.count(v);
+  }
+
+  //---------------------------------------------------------------------------
+  // Ordered traversal. Shards are visited in order, each under its lock, so
+  // f must not call back into the set. With concurrent writers the result is
+  // sorted, but not a snapshot of one moment.
+
+  template <typename F>
+  // requires UnaryFunction<F, const value_type&>
+  void for_each(F f) const {
+    std::shared_lock<std::shared_timed_mutex> layout(layout_mutex_);
+    for (const auto& s : impl_.shards_) {
+      std::lock_guard<std::mutex> lock(s->value.mutex);
+      for (const auto& x : s->value.set)
+        f(x);
+    }
+  }
+
+  sorted_type to_flat_set() const {
+    underlying_type res;
+    for_each([&](const value_type& x) { res.push_back(x); });
+    return sorted_type(sorted_unique, std::move(res), value_comp());
+  }
+
+  //---------------------------------------------------------------------------
+  // Getters.
+
+  key_compare key_comp() const { return impl_; }
+  value_compare value_comp() const { return impl_; }
+};
+
+template <typename Key, typename Comparator, typename UnderlyingType>
+constexpr size_t
+    sharded_flat_set<Key, Comparator, UnderlyingType>::kDefaultShardCount;
+
+template <typename Key, typename Comparator, typename UnderlyingType>
+constexpr size_t
+    sharded_flat_set<Key, Comparator, UnderlyingType>::kMinSplitSize;
+
+}  // namespace lib
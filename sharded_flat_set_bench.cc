@@ -0,0 +1,86 @@
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "lib.h"
+#include "sharded_flat_set.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+constexpr int kSetSize = 1 << 20;
+
+// Even numbers, the writers insert and erase odd ones.
+std::vector<int> initial_elements() {
+  std::vector<int> res(kSetSize);
+  for (int i = 0; i < kSetSize; ++i)
+    res[static_cast<size_t>(i)] = 2 * i;
+  return res;
+}
+
+struct mutex_set {
+  std::mutex mutex;
+  lib::flat_set<int> set;
+
+  mutex_set() {
+    auto elements = initial_elements();
+    set = lib::flat_set<int>(lib::sorted_unique, elements.begin(),
+                             elements.end());
+  }
+
+  void insert(int x) {
+    std::lock_guard<std::mutex> lock(mutex);
+    set.insert(x);
+  }
+
+  void erase(int x) {
+    std::lock_guard<std::mutex> lock(mutex);
+    set.erase(x);
+  }
+};
+
+struct sharded_set {
+  lib::sharded_flat_set<int> set;
+
+  sharded_set() {
+    auto elements = initial_elements();
+    set.insert(elements.begin(), elements.end());
+  }
+
+  void insert(int x) { set.insert(x); }
+  void erase(int x) { set.erase(x); }
+};
+
+template <typename Set>
+Set& shared_set() {
+  static Set res;
+  return res;
+}
+
+// Every iteration inserts a random odd number and erases it, so the size
+// stays the same.
+template <typename Set>
+void concurrent_writes(benchmark::State& state) {
+  Set& set = shared_set<Set>();
+
+  std::mt19937 g(static_cast<unsigned>(state.thread_index()));
+  std::uniform_int_distribution<> dis(0, kSetSize - 1);
+  for (auto _ : state) {
+    int x = 2 * dis(g) + 1;
+    set.insert(x);
+    set.erase(x);
+  }
+  state.SetItemsProcessed(2 * state.iterations());
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(concurrent_writes, mutex_set)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(concurrent_writes, sharded_set)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "lib.h"
+
+#include "benchmark/benchmark.h"
+
+namespace {
+
+using int_vec = std::vector<int>;
+
+// size elements, duplicates% of which are repeats of the others.
+int_vec generate_input(size_t size, size_t duplicates) {
+  std::mt19937 g;
+  const size_t unique_size =
+      std::max<size_t>(size * (100 - duplicates) / 100, 1);
+
+  int_vec res(size);
+  auto unique_l = res.begin() + static_cast<std::ptrdiff_t>(unique_size);
+  std::iota(res.begin(), unique_l, 0);
+  std::uniform_int_distribution<size_t> dis(0, unique_size - 1);
+  for (size_t i = unique_size; i < size; ++i)
+    res[i] = res[dis(g)];
+  std::shuffle(res.begin(), res.end(), g);
+  return res;
+}
+
+void sizes_and_duplicates(benchmark::internal::Benchmark* bench) {
+  for (int size : {1000, 1 << 20}) {
+    for (int duplicates = 0; duplicates <= 90; duplicates += 10)
+      bench->Args({size, duplicates});
+  }
+}
+
+struct std_sort_unique {
+  template <typename I>
+  I operator()(I f, I l) {
+    std::sort(f, l);
+    return std::unique(f, l);
+  }
+};
+
+struct merge_sort_and_unique {
+  template <typename I>
+  I operator()(I f, I l) {
+    return lib::merge_sort_and_unique(f, l);
+  }
+};
+
+template <typename Alg>
+void sort_and_unique_benchmark(benchmark::State& state) {
+  const int_vec input = generate_input(static_cast<size_t>(state.range(0)),
+                                       static_cast<size_t>(state.range(1)));
+  int_vec v;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    v = input;
+    state.ResumeTiming();
+
+    benchmark::DoNotOptimize(Alg{}(v.begin(), v.end()));
+  }
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(sort_and_unique_benchmark, std_sort_unique)
+    ->Apply(sizes_and_duplicates);
+BENCHMARK_TEMPLATE(sort_and_unique_benchmark, merge_sort_and_unique)
+    ->Apply(sizes_and_duplicates);
+
+BENCHMARK_MAIN();